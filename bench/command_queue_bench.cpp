@@ -0,0 +1,133 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "MpscQueue.h"
+
+/************************
+ *
+ *  MpscQueue vs a mutex protected vector (how MainThreadQueue works): producers push small
+ *  commands while one consumer drains, as the main thread does every frame
+ *
+ ************************/
+
+namespace {
+  constexpr size_t COMMANDS_PER_PRODUCER = 1'000'000;
+  constexpr size_t CAPACITY = 4096;
+
+  struct Command {
+    uint64_t producer{0};
+    uint64_t value{0};
+  };
+
+  class LockedQueue {
+    public:
+      bool try_push(Command &&command) {
+        const std::lock_guard lock(m_mutex);
+        if(m_commands.size() == CAPACITY) {
+          return false;
+        }
+        m_commands.push_back(command);
+        return true;
+      }
+
+      // Swaps the queue out like MainThreadQueue::drain()
+      template <typename Fn>
+      void drain(Fn &&fn) {
+        {
+          const std::lock_guard lock(m_mutex);
+          std::swap(m_commands, m_draining);
+        }
+        for(const auto &command : m_draining) {
+          fn(command);
+        }
+        m_draining.clear();
+      }
+
+    private:
+      std::mutex m_mutex;
+      std::vector<Command> m_commands;
+      std::vector<Command> m_draining;
+  };
+
+  class LockFreeQueue {
+    public:
+      bool try_push(Command &&command) {
+        return m_queue.try_push(std::move(command));
+      }
+
+      template <typename Fn>
+      void drain(Fn &&fn) {
+        Command command;
+        while(m_queue.try_pop(command)) {
+          fn(command);
+        }
+      }
+
+    private:
+      mv::MpscQueue<Command> m_queue{CAPACITY};
+  };
+
+  template <typename Queue>
+  void run(std::string_view name, size_t producers) {
+    Queue queue;
+    std::atomic<uint64_t> full{0};
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for(size_t p = 0; p < producers; p++) {
+      threads.emplace_back([&queue, &full, p] {
+        uint64_t failed = 0;
+        for(uint64_t i = 0; i < COMMANDS_PER_PRODUCER; i++) {
+          while(!queue.try_push(Command{p, i})) {
+            ++failed;
+            std::this_thread::yield();
+          }
+        }
+        full += failed;
+      });
+    }
+
+    // Commands of a producer must arrive in order
+    std::vector<uint64_t> next(producers, 0);
+    size_t received = 0;
+    bool ordered = true;
+    while(received < producers * COMMANDS_PER_PRODUCER) {
+      queue.drain([&](const Command &command) {
+        ordered = ordered && command.value == next[command.producer];
+        next[command.producer] = command.value + 1;
+        ++received;
+      });
+    }
+    for(auto &thread : threads) {
+      thread.join();
+    }
+
+    const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fmt::print("{:>12}, {} producers: {:8.2f} mS, {:6.1f} M commands/s, {} pushes found it full{}\n",
+      name,
+      producers,
+      ms,
+      static_cast<double>(received) / ms / 1000.0,// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      full.load(),
+      ordered ? "" : " (OUT OF ORDER)");
+  }
+}// namespace
+
+int main() {
+  for(const size_t producers : {1U, 2U, 4U, 8U}) {
+    run<LockedQueue>("mutex", producers);
+    run<LockFreeQueue>("MpscQueue", producers);
+  }
+  return 0;
+}
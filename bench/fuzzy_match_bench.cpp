@@ -0,0 +1,88 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Dataset.h"
+#include "FuzzyMatch.h"
+#include "ItemStore.h"
+#include "ItemView.h"
+#include "ThreadPool.h"
+
+/************************
+ *
+ *  Fuzzy ranking: scoring every item on one thread vs an ItemView job on the thread pool
+ *
+ ************************/
+
+namespace {
+  constexpr size_t ITEM_COUNT = 5'000'000;
+
+  std::vector<std::string> make_items() {
+    const std::vector<std::string_view> words = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliett"};
+    std::mt19937 rng(1337);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    std::uniform_int_distribution<size_t> word(0, words.size() - 1);
+
+    std::vector<std::string> items;
+    items.reserve(ITEM_COUNT);
+    for(size_t i = 0; i < ITEM_COUNT; i++) {
+      items.push_back(fmt::format("{}/{:09}/{}_{}", words[word(rng)], i, words[word(rng)], words[word(rng)]));
+    }
+    return items;
+  }
+
+  template <typename Fn>
+  double time_ms(Fn &&fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void score_all(const mv::ItemStore &store, std::string_view query) {
+    const mv::match::FuzzyPattern pattern{query};
+    size_t matches = 0;
+    const auto ms = time_ms([&] {
+      for(size_t i = 0; i < store.size(); i++) {
+        if(pattern.score(store[i])) {
+          ++matches;
+        }
+      }
+    });
+    fmt::print("  {:>24}: {:8.2f} mS ({} matches)\n", "score, one thread", ms, matches);
+  }
+
+  void rank(const mv::Dataset &data, mv::ThreadPool &pool, std::string_view query) {
+    mv::ItemView view;
+    const auto ms = time_ms([&] {
+      view.set_query(query, true, data, pool);
+      while(view.busy()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        view.update(data, pool);
+      }
+    });
+    fmt::print("  {:>24}: {:8.2f} mS ({} matches, best {} kept)\n", fmt::format("rank, {} threads", pool.thread_count()), ms, view.matches(data.items()), view.size(data.items()));
+  }
+}// namespace
+
+int main() {
+  mv::Dataset data;
+  for(const auto &item : make_items()) {
+    data.append(item);
+  }
+  mv::ThreadPool pool;
+  fmt::print("{} items\n", data.items().size());
+
+  for(const auto *query : {"dlt", "chrl7", "hotel99", "ajxq"}) {
+    fmt::print("\"{}\"\n", query);
+    score_all(data.items(), query);
+    rank(data, pool, query);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "ItemStore.h"
+
+/************************
+ *
+ *  ItemStore vs std::vector<std::string>: memory per item and scan throughput
+ *
+ ************************/
+
+namespace {
+  std::atomic<size_t> allocated_bytes{0};// NOLINT: cppcoreguidelines-avoid-non-const-global-variables
+
+  constexpr size_t ITEM_COUNT = 5'000'000;
+  constexpr int SCAN_ROUNDS = 5;
+
+  std::vector<std::string> make_items() {
+    const std::vector<std::string_view> words = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliett"};
+    std::mt19937 rng(1337);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    std::uniform_int_distribution<size_t> word(0, words.size() - 1);
+
+    std::vector<std::string> items;
+    items.reserve(ITEM_COUNT);
+    for(size_t i = 0; i < ITEM_COUNT; i++) {
+      items.push_back(fmt::format("{}-{}-{}", words[word(rng)], i, words[word(rng)]));
+    }
+    return items;
+  }
+
+  template <typename Fn>
+  double time_ms(Fn &&fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  template <typename Store>
+  void scan(std::string_view name, const Store &store, size_t text_bytes) {
+    size_t matches = 0;
+    const auto ms = time_ms([&] {
+      for(int round = 0; round < SCAN_ROUNDS; round++) {
+        for(size_t i = 0; i < store.size(); i++) {
+          if(std::string_view{store[i]}.find("42") != std::string_view::npos) {
+            ++matches;
+          }
+        }
+      }
+    }) / SCAN_ROUNDS;
+    fmt::print("{:>24}: scan {:8.2f} mS, {:8.1f} M items/s, {:8.1f} MB/s ({} matches)\n", name, ms, static_cast<double>(store.size()) / ms / 1000.0, static_cast<double>(text_bytes) / ms / 1000.0, matches / SCAN_ROUNDS);
+  }
+
+  // Same scan but chunk by chunk, the way the filters walk the store
+  void scan_chunks(const mv::ItemStore &store, size_t text_bytes) {
+    size_t matches = 0;
+    const auto ms = time_ms([&] {
+      for(int round = 0; round < SCAN_ROUNDS; round++) {
+        for(const auto &chunk : store.chunks()) {
+          for(uint32_t i = 0; i < chunk->size(); i++) {
+            if((*chunk)[i].find("42") != std::string_view::npos) {
+              ++matches;
+            }
+          }
+        }
+      }
+    }) / SCAN_ROUNDS;
+    fmt::print("{:>24}: scan {:8.2f} mS, {:8.1f} M items/s, {:8.1f} MB/s ({} matches)\n", "ItemStore (chunks)", ms, static_cast<double>(store.size()) / ms / 1000.0, static_cast<double>(text_bytes) / ms / 1000.0, matches / SCAN_ROUNDS);
+  }
+}// namespace
+
+void *operator new(size_t size) {
+  allocated_bytes += size;
+  if(void *p = std::malloc(size)) {// NOLINT: cppcoreguidelines-no-malloc,hicpp-no-malloc
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);// NOLINT: cppcoreguidelines-no-malloc,hicpp-no-malloc
+}
+
+void operator delete(void *p, size_t /*size*/) noexcept {
+  std::free(p);// NOLINT: cppcoreguidelines-no-malloc,hicpp-no-malloc
+}
+
+int main() {
+  const auto source = make_items();
+  size_t text_bytes = 0;
+  for(const auto &item : source) {
+    text_bytes += item.size();
+  }
+  fmt::print("{} items, {:.1f} bytes of text per item\n", source.size(), static_cast<double>(text_bytes) / static_cast<double>(source.size()));
+
+  auto before = allocated_bytes.load();
+  std::vector<std::string> strings;
+  const auto strings_ms = time_ms([&] {
+    for(const auto &item : source) {
+      strings.push_back(item);
+    }
+  });
+  const auto strings_bytes = allocated_bytes.load() - before;
+
+  before = allocated_bytes.load();
+  mv::ItemStore store;
+  const auto store_ms = time_ms([&] { store.append_bulk(source); });
+  const auto store_bytes = allocated_bytes.load() - before;
+
+  const auto per_item = [](size_t bytes) { return static_cast<double>(bytes) / static_cast<double>(ITEM_COUNT); };
+  fmt::print("{:>24}: append {:8.2f} mS, {:6.1f} bytes/item allocated (incl. growth)\n", "vector<string>", strings_ms, per_item(strings_bytes));
+  fmt::print("{:>24}: append {:8.2f} mS, {:6.1f} bytes/item allocated, {:6.1f} bytes/item in use\n", "ItemStore", store_ms, per_item(store_bytes), per_item(store.memory_usage()));
+
+  scan("vector<string>", strings, text_bytes);
+  scan("ItemStore", store, text_bytes);
+  scan_chunks(store, text_bytes);
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "ItemStore.h"
+#include "StringMatch.h"
+
+/************************
+ *
+ *  Brute force item filtering: std::string::find per item vs the match kernels over chunk text
+ *
+ ************************/
+
+namespace {
+  constexpr size_t ITEM_COUNT = 5'000'000;
+  constexpr int SCAN_ROUNDS = 5;
+
+  struct Query {
+    std::string_view name;
+    std::string_view needle;
+    bool ignore_case;
+    bool prefix;
+  };
+
+  std::vector<std::string> make_items() {
+    const std::vector<std::string_view> words = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliett"};
+    std::mt19937 rng(1337);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    std::uniform_int_distribution<size_t> word(0, words.size() - 1);
+
+    std::vector<std::string> items;
+    items.reserve(ITEM_COUNT);
+    for(size_t i = 0; i < ITEM_COUNT; i++) {
+      items.push_back(fmt::format("{} {:09} {} {}", words[word(rng)], i, words[word(rng)], words[word(rng)]));
+    }
+    return items;
+  }
+
+  template <typename Fn>
+  double time_ms(Fn &&fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void report(std::string_view name, double ms, size_t text_bytes, size_t matches) {
+    fmt::print("  {:>28}: {:8.2f} mS, {:8.1f} MB/s ({} matches)\n", name, ms, static_cast<double>(text_bytes) / ms / 1000.0, matches);
+  }
+
+  // What the filter did before the kernels: one std::string::find per item, lower casing a copy for ignore case
+  void baseline(const std::vector<std::string> &items, const Query &query, size_t text_bytes) {
+    std::string needle{query.needle};
+    if(query.ignore_case) {
+      std::transform(needle.begin(), needle.end(), needle.begin(), mv::match::to_lower);
+    }
+    size_t matches = 0;
+    std::string lower;
+    const auto ms = time_ms([&] {
+      for(int round = 0; round < SCAN_ROUNDS; round++) {
+        for(const auto &item : items) {
+          const std::string *text = &item;
+          if(query.ignore_case) {
+            lower = item;
+            std::transform(lower.begin(), lower.end(), lower.begin(), mv::match::to_lower);
+            text = &lower;
+          }
+          const auto pos = text->find(needle);
+          matches += (query.prefix ? pos == 0 : pos != std::string::npos) ? 1 : 0;
+        }
+      }
+    }) / SCAN_ROUNDS;
+    report("std::string::find", ms, text_bytes, matches / SCAN_ROUNDS);
+  }
+
+  void kernel(const mv::ItemStore &store, const Query &query, mv::match::Isa isa, size_t text_bytes) {
+    mv::match::use_isa(isa);
+    const mv::match::Pattern pattern{query.needle, query.ignore_case, query.prefix};
+    size_t matches = 0;
+    const auto ms = time_ms([&] {
+      for(int round = 0; round < SCAN_ROUNDS; round++) {
+        for(const auto &chunk : store.chunks()) {
+          pattern.for_each_match(*chunk, 0, chunk->size(), [&matches](uint32_t /*index*/) { ++matches; });
+        }
+      }
+    }) / SCAN_ROUNDS;
+    report(fmt::format("{} chunk scan", mv::match::ISA_NAMES.at(mv::match::active_isa())), ms, text_bytes, matches / SCAN_ROUNDS);
+  }
+}// namespace
+
+int main() {
+  const auto items = make_items();
+  mv::ItemStore store;
+  store.append_bulk(items);
+  size_t text_bytes = 0;
+  for(const auto &item : items) {
+    text_bytes += item.size();
+  }
+  fmt::print("{} items, {:.1f} bytes of text per item, best kernel {}\n", items.size(), static_cast<double>(text_bytes) / static_cast<double>(items.size()), mv::match::ISA_NAMES.at(mv::match::best_isa()));
+
+  const std::vector<Query> queries = {
+    {"rare substring", "0012345", false, false},
+    {"common substring", "hotel", false, false},
+    {"ignore case", "HOTEL IND", true, false},
+    {"prefix", "delta 0001", false, true},
+    {"prefix, ignore case", "DELTA 0001", true, true},
+  };
+  for(const auto &query : queries) {
+    fmt::print("{} \"{}\"\n", query.name, query.needle);
+    baseline(items, query, text_bytes);
+    for(int isa = mv::match::SCALAR; isa <= mv::match::best_isa(); isa++) {
+      kernel(store, query, static_cast<mv::match::Isa>(isa), text_bytes);
+    }
+  }
+  return 0;
+}
@@ -6,12 +6,19 @@
 #include <cassert>
 #include <chrono>
 #include <cstring>
+#include <ctime>
 #include <exception>
 #include <filesystem>
 #include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
 #include <thread>
+#include <variant>
+#include <vector>
 
 #include <SDL2/SDL.h>
+#include <fmt/chrono.h>
 #include <fmt/format.h>
 #include <imgui.h>
 #include <imgui_impl_sdl.h>
@@ -20,8 +27,11 @@
 #include <spdlog/spdlog.h>
 
 #include "Application.h"
+#include "Dataset.h"
 #include "DebugWindow.h"
 #include "ImGuiUtil.h"
+#include "Profiler.h"
+#include "ProfilerWindow.h"
 #include "SplitViewWindow.h"
 
 #include "CourierPrime.h"
@@ -29,14 +39,51 @@
 constexpr int WIDTH = 1920 /*2560*/ /*3840*/;
 constexpr int HEIGHT = 1080 /*1440*/ /*2160 */;
 
+namespace {
+  // CPU time of the calling (render) thread, falls back to process time where not available.
+  std::chrono::nanoseconds thread_cpu_time() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(static_cast<double>(std::clock()) / CLOCKS_PER_SEC));
+#endif
+  }
+}// namespace
+
 namespace mv {
   using namespace std::chrono_literals;
-  Application::Application() {
-    setup_sdl();
+  Application::Application() : Application(ApplicationOptions{}) {}
+
+  Application::Application(const ApplicationOptions &options) : m_options(options), m_reactive(options.reactive), m_frame_time_series(options.history_length) {
+    MV_PROFILE_THREAD_NAME("main");
+    if(m_options.headless) {
+      setup_headless_sdl();
+    } else {
+      setup_sdl();
+    }
     setup_imgui();
 
-    m_windows.push_back(std::make_unique<DebugWindow>());
-    m_windows.push_back(std::make_unique<SplitViewWindow>());
+    open_window(std::make_unique<DebugWindow>(*this));
+    open_window(std::make_unique<SplitViewWindow>(*this, open_store(m_options.store_path)));
+  }
+
+  std::shared_ptr<Dataset> Application::open_store(const std::filesystem::path &path) {
+    if(path.empty()) {
+      return nullptr;
+    }
+    try {
+      if(std::filesystem::exists(path)) {
+        return Dataset::open(path);
+      }
+      auto data = std::make_shared<Dataset>();
+      data->store_in(path);
+      return data;
+    } catch(const std::exception &e) {
+      spdlog::error("{}", e.what());
+      return nullptr;
+    }
   }
 
   Application::~Application() {
@@ -52,6 +99,47 @@ namespace mv {
     m_window = shared_window_t{SDL_CreateWindow("MultiView v0.0.1", 0, 0, WIDTH, HEIGHT, SDL_WINDOW_METAL | SDL_WINDOW_RESIZABLE), &SDL_DestroyWindow};
     m_renderer = shared_renderer_t{SDL_CreateRenderer(m_window.get(), -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC), &SDL_DestroyRenderer};
     SDL_ShowWindow(m_window.get());
+
+    s_redraw_event = SDL_RegisterEvents(1);
+  }
+
+  // No display and no GPU needed: the dummy video driver still gives us a window for the ImGui
+  // platform backend, drawing goes through the software renderer into a plain surface.
+  void Application::setup_headless_sdl() {
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {// NOLINT:hicpp-signed-bitwise
+      throw std::runtime_error(fmt::format("Could not initialize SDL: {}", SDL_GetError()));
+    }
+
+    m_window = shared_window_t{SDL_CreateWindow("MultiView v0.0.1", 0, 0, WIDTH, HEIGHT, SDL_WINDOW_HIDDEN), &SDL_DestroyWindow};
+    m_offscreen_surface = shared_surface_t{SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888), &SDL_FreeSurface};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    if(!m_window || !m_offscreen_surface) {
+      throw std::runtime_error(fmt::format("Could not create headless render target: {}", SDL_GetError()));
+    }
+    m_renderer = shared_renderer_t{SDL_CreateSoftwareRenderer(m_offscreen_surface.get()), &SDL_DestroyRenderer};
+    if(!m_renderer) {
+      throw std::runtime_error(fmt::format("Could not create software renderer: {}", SDL_GetError()));
+    }
+    m_vsync = false;
+
+    s_redraw_event = SDL_RegisterEvents(1);
+  }
+
+  void Application::set_vsync(bool enabled) {
+    if(SDL_RenderSetVSync(m_renderer.get(), enabled ? 1 : 0) != 0) {
+      spdlog::warn("Could not change vsync: {}", SDL_GetError());
+      return;
+    }
+    m_vsync = enabled;
+  }
+
+  void Application::request_redraw() {
+    if(s_redraw_event == static_cast<Uint32>(-1)) {
+      return;
+    }
+    SDL_Event event{};
+    event.type = s_redraw_event;
+    SDL_PushEvent(&event);
   }
 
   void Application::setup_imgui() {
@@ -67,7 +155,11 @@ namespace mv {
     auto &io = ImGui::GetIO();
     io.ConfigWindowsResizeFromEdges = true;
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;// NOLINT:hicpp-signed-bitwise
-    io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;// NOLINT:hicpp-signed-bitwise
+    if(m_options.headless) {
+      io.IniFilename = nullptr;
+    } else {
+      io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;// NOLINT:hicpp-signed-bitwise
+    }
 
     load_fonts();
   }
@@ -75,76 +167,246 @@ namespace mv {
   int Application::run() {
     using namespace std::chrono_literals;
 
+    if(m_options.headless) {
+      return run_headless();
+    }
+
     // Main loop
     bool should_quit{false};
     try {
       while(!should_quit) {
+        m_frame_timeline.begin_frame();
         should_quit = process_events();
+        if(!needs_frame()) {
+          continue;
+        }
 
-        begin_render();
-        render();
-        end_render();
+        render_frame();
 
-        if(m_window_is_hidden) {
-          std::this_thread::sleep_for(100ms);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        m_pending_frames = std::max(0, m_pending_frames - 1);
+        {
+          auto phase = m_frame_timeline.measure(PHASE_PACING);
+          m_frame_governor.wait_for_next_frame();
         }
+        m_frame_timeline.end_frame();
+        profiler::Profiler::instance().collect();
       }
     } catch(std::exception &e) {
       spdlog::error("{}", e.what());
     } catch(...) {
       spdlog::error("Error occured..");
     }
+
+    if(!m_options.trace_path.empty()) {
+      export_trace(m_options.trace_path);
+    }
+    return 0;
+  }
+
+  void Application::export_trace(const std::filesystem::path &path) {
+    const auto &profiler = profiler::Profiler::instance();
+
+    TraceExporter::Trace trace;
+    trace.path = path;
+    trace.thread_names = profiler.thread_names();
+    trace.frames.reserve(m_frame_timeline.size());
+    for(size_t i = 0; i < m_frame_timeline.size(); i++) {
+      trace.frames.push_back(m_frame_timeline.at(i));
+    }
+    trace.zones.reserve(profiler.history_size());
+    for(size_t i = 0; i < profiler.history_size(); i++) {
+      trace.zones.push_back(profiler.history_at(i));
+    }
+    m_trace_exporter.export_async(std::move(trace));
+  }
+
+  int Application::run_headless() {
+    const auto frames = static_cast<size_t>(std::max(1, m_options.headless_frames));
+    m_reactive = false;
+    std::vector<double> wall_ms;
+    std::vector<double> cpu_ms;
+    wall_ms.reserve(frames);
+    cpu_ms.reserve(frames);
+
+    try {
+      for(size_t frame = 0; frame < frames; frame++) {
+        const auto wall_start = std::chrono::steady_clock::now();
+        const auto cpu_start = thread_cpu_time();
+
+        m_frame_timeline.begin_frame();
+        if(process_events()) {
+          break;
+        }
+        render_frame();
+        m_frame_timeline.end_frame();
+        profiler::Profiler::instance().collect();
+
+        cpu_ms.push_back(std::chrono::duration<double, std::milli>(thread_cpu_time() - cpu_start).count());
+        wall_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count());
+      }
+    } catch(std::exception &e) {
+      spdlog::error("{}", e.what());
+      return -1;
+    }
+
+    const auto report = [](std::string_view name, std::vector<double> &samples) {
+      if(samples.empty()) {
+        return;
+      }
+      std::sort(samples.begin(), samples.end());
+      const auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())))];
+      };
+      const auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+      spdlog::info("{:>4} mS/frame: min {:.3f}  mean {:.3f}  p50 {:.3f}  p90 {:.3f}  p99 {:.3f}  max {:.3f}",// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        name,
+        samples.front(),
+        mean,
+        percentile(0.5),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        percentile(0.9),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        percentile(0.99),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        samples.back());
+    };
+
+    spdlog::info("Headless run: {} frames, {} windows", cpu_ms.size(), m_windows.size());
+    report("cpu", cpu_ms);
+    report("wall", wall_ms);
+
+    if(!m_options.trace_path.empty()) {
+      export_trace(m_options.trace_path);
+    }
     return 0;
   }
 
+  // In reactive mode a frame is only rendered when an event arrived during the last few frames
+  // (ImGui needs a couple of frames to settle hover/popup state), a window is dirty or a window animates.
+  bool Application::needs_frame() const {
+    if(!m_reactive || m_pending_frames > 0) {
+      return true;
+    }
+    return std::any_of(m_windows.begin(), m_windows.end(), [](const std::unique_ptr<Window> &w) { return w->is_dirty() || w->needs_continuous_redraw(); });
+  }
+
   bool Application::process_events() {
+    MV_PROFILE_FUNCTION();
     bool should_quit = false;
     SDL_Event event{};
+
+    // Nothing to draw, block until something happens. The timeout still gives us a frame now and then.
+    if(m_reactive && !needs_frame()) {
+      if(SDL_WaitEventTimeout(&event, REACTIVE_IDLE_TIMEOUT_MS) != 0) {
+        should_quit = process_event(event);
+      } else {
+        m_pending_frames = 1;
+      }
+    }
+
+    auto phase = m_frame_timeline.measure(PHASE_EVENTS);
     while(SDL_PollEvent(&event) != 0) {
-      ImGui_ImplSDL2_ProcessEvent(&event);
-      switch(event.type) {
-      case SDL_QUIT:
-        should_quit = true;
+      should_quit = process_event(event) || should_quit;
+    }
+    return should_quit;
+  }
+
+  bool Application::process_event(const SDL_Event &event) {
+    bool should_quit = false;
+    m_pending_frames = REACTIVE_SETTLE_FRAMES;
+
+    if(event.type == s_redraw_event) {
+      return should_quit;
+    }
+
+    ImGui_ImplSDL2_ProcessEvent(&event);
+    switch(event.type) {
+    case SDL_QUIT:
+      should_quit = true;
+      break;
+    case SDL_WINDOWEVENT:
+      switch(event.window.event) {
+      case SDL_WINDOWEVENT_FOCUS_GAINED:
+        m_window_has_focus = true;
+        break;
+      case SDL_WINDOWEVENT_FOCUS_LOST:
+        m_window_has_focus = false;
+        break;
+      case SDL_WINDOWEVENT_SHOWN:
+        m_window_is_hidden = false;
+        break;
+      case SDL_WINDOWEVENT_HIDDEN:
+        m_window_is_hidden = true;
+        break;
+      case SDL_WINDOWEVENT_MINIMIZED:
+        m_window_is_minimized = true;
+        break;
+      case SDL_WINDOWEVENT_RESTORED:
+      case SDL_WINDOWEVENT_MAXIMIZED:
+        m_window_is_minimized = false;
         break;
-      case SDL_WINDOWEVENT:
-        switch(event.window.event) {
-        case SDL_WINDOWEVENT_FOCUS_GAINED:
-        case SDL_WINDOWEVENT_SHOWN:
-          m_window_is_hidden = false;
+      }
+      update_governor_state();
+      break;
+    case SDL_KEYDOWN:
+      if((event.key.keysym.mod & KMOD_CTRL) != 0) {
+        switch(event.key.keysym.sym) {
+        case SDLK_n:
+          open_window(std::make_unique<DebugWindow>(*this));
           break;
-        case SDL_WINDOWEVENT_FOCUS_LOST:
-        case SDL_WINDOWEVENT_HIDDEN:
-          m_window_is_hidden = true;
+        case SDLK_p:
+          open_window(std::make_unique<ProfilerWindow>(*this));
           break;
         }
-        break;
-      case SDL_KEYDOWN:
-        if((event.key.keysym.mod & KMOD_CTRL) != 0) {
-          switch(event.key.keysym.sym) {
-          case SDLK_n:
-            m_windows.push_back(std::make_unique<DebugWindow>());
-            break;
-          }
-        } else if((event.key.keysym.mod & KMOD_GUI) != 0) {
-          switch(event.key.keysym.sym) {
-          case SDLK_n:
-            m_windows.push_back(std::make_unique<SplitViewWindow>());
-            break;
-          case SDLK_PLUS:
-            ++m_default_font;
-            break;
-          case SDLK_MINUS:
-            --m_default_font;
-            break;
-          }
+      } else if((event.key.keysym.mod & KMOD_GUI) != 0) {
+        switch(event.key.keysym.sym) {
+        case SDLK_n:
+          open_window(std::make_unique<SplitViewWindow>(*this, m_current_dataset.lock()));
+          break;
+        case SDLK_PLUS:
+          ++m_default_font;
+          break;
+        case SDLK_MINUS:
+          --m_default_font;
+          break;
         }
-        break;
       }
+      break;
     }
     return should_quit;
   }
 
+  void Application::update_governor_state() {
+    if(m_window_is_minimized) {
+      m_frame_governor.set_state(FrameGovernor::MINIMIZED);
+    } else if(m_window_is_hidden) {
+      m_frame_governor.set_state(FrameGovernor::HIDDEN);
+    } else if(!m_window_has_focus) {
+      m_frame_governor.set_state(FrameGovernor::UNFOCUSED);
+    } else {
+      m_frame_governor.set_state(FrameGovernor::FOCUSED);
+    }
+  }
+
+  void Application::render_frame() {
+    MV_PROFILE_FUNCTION();
+    {
+      auto phase = m_frame_timeline.measure(PHASE_BEGIN_RENDER);
+      begin_render();
+    }
+    const auto delta_time = ImGui::GetIO().DeltaTime;
+    m_frame_time_series.push(delta_time * 1000.0F);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    m_frame_time_stats.record(static_cast<uint64_t>(delta_time * 1'000'000.0F), now_ns());// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    {
+      auto phase = m_frame_timeline.measure(PHASE_WINDOWS);
+      m_commands.drain([this](Command &&command) { apply(std::move(command)); });
+      m_tasks.update();
+      m_main_queue.drain();
+      render();
+    }
+    m_thread_pool_stats.collect(m_thread_pool, now_ns());
+    end_render();
+  }
+
   void Application::begin_render() {
+    MV_PROFILE_FUNCTION();
     set_theme();
     ImGui_ImplSDLRenderer_NewFrame();
     ImGui_ImplSDL2_NewFrame(m_window.get());
@@ -166,7 +428,29 @@ namespace mv {
     ImGui::DockSpace(dockspace_id, ImVec2(0.0F, 0.0F), ImGuiDockNodeFlags_AutoHideTabBar);
   }
 
+  void Application::apply(Command &&command) {
+    if(auto *open = std::get_if<command::OpenWindow>(&command); open != nullptr && open->make) {
+      if(auto window = open->make(*this)) {
+        const auto handle = open_window(std::move(window));
+        if(open->opened) {
+          open->opened(handle);
+        }
+      }
+    } else if(auto *append = std::get_if<command::AppendItems>(&command)) {
+      if(const auto dataset = append->dataset.lock()) {
+        dataset->append_bulk(append->items);
+      }
+    } else if(auto *close_window = std::get_if<command::CloseWindow>(&command)) {
+      if(auto *target = window(close_window->window)) {
+        target->close();
+      }
+    } else if(auto *custom = std::get_if<command::Custom>(&command); custom != nullptr && custom->run) {
+      custom->run(*this);
+    }
+  }
+
   void Application::render() {
+    MV_PROFILE_FUNCTION();
     // ImGui::ShowDemoWindow();
     // ImPlot::ShowDemoWindow();
     // ImGui::ShowMetricsWindow();
@@ -174,19 +458,46 @@ namespace mv {
     render_main_menu();
     render_about_box();
 
-    for(auto &win : m_windows) {
-      win->render();
+    // By position, windows opened by a window while rendering are added at the end and wait for
+    // the next frame
+    const auto count = m_windows.size();
+    for(size_t i = 0; i < count; i++) {
+      auto &win = *m_windows[i];
+      const auto start = now_ns();
+      win.update_visibility();
+      win.update();
+      win.render();
+      const auto end = now_ns();
+      win.set_last_render_ms(static_cast<float>(end - start) / FrameRecord::NS_PER_MS);
+      m_frame_timeline.record_window(win.handle(), start, end);
+      win.clear_dirty();
+    }
+    // Backwards, erasing moves the last window into the hole
+    for(auto i = m_windows.size(); i-- > 0;) {
+      if(m_windows[i]->should_close()) {
+        m_windows.erase(m_windows.key(i));
+      }
     }
-    m_windows.erase(std::remove_if(m_windows.begin(), m_windows.end(), [](const std::unique_ptr<Window> &w) { return w->should_close(); }), m_windows.end());
   }
 
   void Application::end_render() {
+    MV_PROFILE_FUNCTION();
     ImGui::PopFont();
     ImGui::End();// Dockspace window
-    ImGui::Render();
-    SDL_RenderClear(m_renderer.get());
-    ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
-    SDL_RenderPresent(m_renderer.get());
+    {
+      auto phase = m_frame_timeline.measure(PHASE_IMGUI_RENDER);
+      ImGui::Render();
+    }
+    m_draw_stats.collect(ImGui::GetDrawData());
+    {
+      auto phase = m_frame_timeline.measure(PHASE_RENDER_DRAW_DATA);
+      SDL_RenderClear(m_renderer.get());
+      ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
+    }
+    {
+      auto phase = m_frame_timeline.measure(PHASE_PRESENT);
+      SDL_RenderPresent(m_renderer.get());
+    }
   }
 
   void Application::set_theme() {
@@ -231,6 +542,23 @@ namespace mv {
 
   void Application::render_main_menu() {
     if(ImGui::BeginMainMenuBar()) {
+      if(ImGui::BeginMenu("File")) {
+        if(ImGui::MenuItem("Export trace", nullptr, false, !m_trace_exporter.busy())) {
+          const auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+          std::tm local{};
+          localtime_r(&now, &local);
+          export_trace(fmt::format("multiview-trace-{:%Y%m%d-%H%M%S}.json", local));
+        }
+        ImGui::EndMenu();
+      }
+      if(ImGui::BeginMenu("View")) {
+        ImGui::MenuItem("Reactive rendering", nullptr, &m_reactive);
+        ImGui::Separator();
+        if(ImGui::MenuItem("New profiler", "Ctrl+P")) {
+          open_window(std::make_unique<ProfilerWindow>(*this));
+        }
+        ImGui::EndMenu();
+      }
       if(ImGui::BeginMenu("Help")) {
         if(ImGui::MenuItem("About")) {
           m_show_about = true;
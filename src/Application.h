@@ -3,6 +3,7 @@
 #pragma once
 
 #include <algorithm>
+#include <filesystem>
 #include <fmt/core.h>
 #include <memory>
 #include <numeric>
@@ -15,37 +16,182 @@
 #define UUID_SYSTEM_GENERATOR
 #include <uuid.h>
 
+#include "CommandQueue.h"
+#include "DrawStats.h"
 #include "FontList.h"
+#include "FrameGovernor.h"
+#include "FrameTimeline.h"
+#include "LatencyHistogram.h"
+#include "MainThreadQueue.h"
+#include "MetricSeries.h"
+#include "SlotMap.h"
+#include "ThreadPool.h"
+#include "Task.h"
+#include "ThreadPoolStats.h"
+#include "TraceExporter.h"
 #include "Window.h"
 
 namespace mv {
+  struct ApplicationOptions {
+    // Render with the SDL dummy video driver into an offscreen software target, run a fixed
+    // number of frames as fast as possible and report the frame times.
+    bool headless{false};
+    int headless_frames{DEFAULT_HEADLESS_FRAMES};
+    bool reactive{false};
+    // Chrome trace written when the application exits, empty for none
+    std::string trace_path;
+    // Number of frame time samples kept for the debug windows
+    size_t history_length{MetricSeries<float>::DEFAULT_CAPACITY};
+    // Item store file the first split view window opens, or creates and keeps its items in.
+    // Empty for none.
+    std::string store_path;
+
+    static constexpr int DEFAULT_HEADLESS_FRAMES = 1000;
+  };
+
+  class Dataset;
+
   class Application final {
       using shared_renderer_t = std::shared_ptr<SDL_Renderer>;
       using shared_texture_t = std::shared_ptr<SDL_Texture>;
       using shared_window_t = std::shared_ptr<SDL_Window>;
+      using shared_surface_t = std::shared_ptr<SDL_Surface>;
 
     public:
       Application();
+      explicit Application(const ApplicationOptions &options);
       ~Application();
 
       int run();
 
+      // Wakes up the main loop when reactive rendering is enabled, safe to call from any thread.
+      static void request_redraw();
+
+      [[nodiscard]] FrameGovernor &frame_governor() {
+        return m_frame_governor;
+      }
+
+      [[nodiscard]] const FrameTimeline &frame_timeline() const {
+        return m_frame_timeline;
+      }
+
+      // Frame time (mS) of every rendered frame, shared by all debug windows
+      [[nodiscard]] DecimatedSeries<float> &frame_time_series() {
+        return m_frame_time_series;
+      }
+
+      [[nodiscard]] FrameTimeStats &frame_time_stats() {
+        return m_frame_time_stats;
+      }
+
+      [[nodiscard]] const DrawStats &draw_stats() const {
+        return m_draw_stats;
+      }
+
+      // Background jobs of the windows
+      [[nodiscard]] ThreadPool &thread_pool() {
+        return m_thread_pool;
+      }
+
+      [[nodiscard]] const ThreadPoolStats &thread_pool_stats() const {
+        return m_thread_pool_stats;
+      }
+
+      // Tasks for the main thread, run at the start of the next frame
+      [[nodiscard]] MainThreadQueue &main_queue() {
+        return m_main_queue;
+      }
+
+      // Commands from any thread, applied at the start of the next frame
+      [[nodiscard]] CommandQueue &commands() {
+        return m_commands;
+      }
+
+      // Coroutines of the windows, see Task.h
+      [[nodiscard]] TaskRunner &tasks() {
+        return m_tasks;
+      }
+
+      [[nodiscard]] const SlotMap<std::unique_ptr<Window>> &windows() const {
+        return m_windows;
+      }
+
+      // Null once the window is closed
+      [[nodiscard]] Window *window(WindowHandle handle) {
+        auto *window = m_windows.find(handle);
+        return window != nullptr ? window->get() : nullptr;
+      }
+
+      // Windows can open windows, one opened while rendering is rendered from the next frame
+      WindowHandle open_window(std::unique_ptr<Window> window) {
+        auto &opened = *window;
+        const auto handle = m_windows.insert(std::move(window));
+        opened.set_handle(handle);
+        return handle;
+      }
+
+      // The dataset of the split view window last focused, new split views (⌘+N) show it too
+      void set_current_dataset(const std::shared_ptr<Dataset> &dataset) {
+        m_current_dataset = dataset;
+      }
+
+      [[nodiscard]] bool vsync() const {
+        return m_vsync;
+      }
+
+      void set_vsync(bool enabled);
+
+      // Hands the recorded frames and profiler zones to the background trace writer
+      void export_trace(const std::filesystem::path &path);
+
     private:
-      std::vector<std::unique_ptr<Window>> m_windows;
+      ApplicationOptions m_options;
+      MainThreadQueue m_main_queue{&Application::request_redraw};// must outlive the thread pool
+      CommandQueue m_commands{&Application::request_redraw};
+      TaskRunner m_tasks{m_thread_pool, m_main_queue};// must outlive the thread pool, workers resume the tasks
+      ThreadPool m_thread_pool;// must outlive the windows, their jobs may still be running
+      ThreadPoolStats m_thread_pool_stats;
+      SlotMap<std::unique_ptr<Window>> m_windows;
+      std::weak_ptr<Dataset> m_current_dataset;
       shared_window_t m_window;
+      shared_surface_t m_offscreen_surface;// headless render target, must outlive m_renderer
       shared_renderer_t m_renderer;
 
       FontList m_small_font;
       FontList m_big_font;
       FontList m_default_font;
 
+      bool m_window_has_focus{true};
       bool m_window_is_hidden{false};
+      bool m_window_is_minimized{false};
       bool m_show_about{false};
+      bool m_vsync{true};
+
+      FrameGovernor m_frame_governor;
+      FrameTimeline m_frame_timeline;
+      DecimatedSeries<float> m_frame_time_series;
+      FrameTimeStats m_frame_time_stats;
+      DrawStats m_draw_stats;
+      TraceExporter m_trace_exporter;
+
+      // Reactive (event driven) rendering, see run()
+      bool m_reactive{false};
+      int m_pending_frames{0};
+
+      static inline Uint32 s_redraw_event{static_cast<Uint32>(-1)};
+      static constexpr int REACTIVE_SETTLE_FRAMES = 3;
+      static constexpr int REACTIVE_IDLE_TIMEOUT_MS = 500;
 
 
       void setup_sdl();
+      void setup_headless_sdl();
       void setup_imgui();
 
+      // The dataset of the --store file, null without one or when it can't be opened
+      static std::shared_ptr<Dataset> open_store(const std::filesystem::path &path);
+
+      int run_headless();
+
       void set_theme();
       void load_fonts();
 
@@ -56,6 +202,12 @@ namespace mv {
       void render_main_menu();
       void render_about_box();
 
+      void render_frame();
+      void apply(Command &&command);
+
       bool process_events();
+      bool process_event(const SDL_Event &event);
+      [[nodiscard]] bool needs_frame() const;
+      void update_governor_state();
   };
 }// namespace mv
@@ -0,0 +1,189 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "MpscQueue.h"
+#include "Profiler.h"
+#include "SlotMap.h"
+
+namespace mv {
+  class Application;
+  class Dataset;
+  class Window;
+  using WindowHandle = SlotKey;
+
+  // What other threads can ask the application to do
+  namespace command {
+    // make() runs on the main thread, a null window is ignored. opened (optional) gets the handle of
+    // the window, on the main thread, e.g. to hand it back to the producer.
+    struct OpenWindow {
+      std::function<std::unique_ptr<Window>(Application &)> make;
+      std::function<void(WindowHandle)> opened;
+    };
+
+    struct AppendItems {
+      std::weak_ptr<Dataset> dataset;
+      std::vector<std::string> items;
+    };
+
+    // Nothing happens if the window is already closed
+    struct CloseWindow {
+      WindowHandle window;
+    };
+
+    struct Custom {
+      std::function<void(Application &)> run;
+    };
+  }// namespace command
+
+  using Command = std::variant<command::Custom, command::OpenWindow, command::AppendItems, command::CloseWindow>;
+
+  /**
+   * Commands pushed from any thread, applied by the main thread at the start of a frame.
+   *
+   * The queue is bounded and lock-free (MpscQueue), producers never wait for the main thread to
+   * finish a frame. When it's full try_push() fails and push() backs off until there is room; how
+   * often that happens is kept in stats() so a producer that outruns the frames shows up in the
+   * debug window.
+   */
+  class CommandQueue {
+    public:
+      using Notify = std::function<void()>;
+
+      static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+      struct Stats {
+        uint64_t pushed{0};
+        // try_push() calls that found the queue full
+        uint64_t rejected{0};
+        // push() calls that had to wait for room, and for how long in total
+        uint64_t waits{0};
+        uint64_t wait_ns{0};
+        uint64_t applied{0};
+        // Most commands queued at once
+        size_t peak{0};
+      };
+
+      // Constructed on the consumer (main) thread. notify is called when a command is pushed to a
+      // queue that was drained since the last call, e.g. to wake up the main loop.
+      explicit CommandQueue(Notify notify = nullptr, size_t capacity = DEFAULT_CAPACITY)
+        : m_queue(capacity), m_notify(std::move(notify)), m_consumer(std::this_thread::get_id()) {}
+
+      // Any thread. False when the queue is full, command is left alone then.
+      bool try_push(Command &&command) {
+        if(!m_queue.try_push(std::move(command))) {
+          m_rejected.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        pushed();
+        return true;
+      }
+
+      // Any thread, waits until there is room. The main thread can't wait for itself, there it
+      // returns false when the queue is full.
+      bool push(Command &&command) {
+        if(m_queue.try_push(std::move(command))) {
+          pushed();
+          return true;
+        }
+        if(std::this_thread::get_id() == m_consumer) {
+          m_rejected.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        MV_PROFILE_SCOPE("CommandQueue::wait");
+        const auto start = std::chrono::steady_clock::now();
+        auto backoff = MIN_BACKOFF;
+        while(!m_queue.try_push(std::move(command))) {
+          std::this_thread::sleep_for(backoff);
+          backoff = std::min(backoff * 2, MAX_BACKOFF);
+        }
+        m_waits.fetch_add(1, std::memory_order_relaxed);
+        m_wait_ns.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+        pushed();
+        return true;
+      }
+
+      // Main thread only. Applies the commands queued when it's called (at most a full queue, so a
+      // busy producer can't keep the frame from ending), returns how many.
+      template <typename Apply>
+      size_t drain(Apply &&apply) {
+        // An exchange (not a store) so the commands pushed before the exchange in pushed() are seen
+        m_notified.exchange(false);
+        if(m_queue.size() == 0) {
+          return 0;
+        }
+        MV_PROFILE_SCOPE("CommandQueue::drain");
+        size_t applied = 0;
+        Command command;
+        while(applied < m_queue.capacity() && m_queue.try_pop(command)) {
+          apply(std::move(command));
+          ++applied;
+        }
+        m_applied.fetch_add(applied, std::memory_order_relaxed);
+        // Whatever is still queued now (pushed while applying, or over the limit) gets a wakeup of
+        // its own, the flag was cleared before it was pushed or its notify already woke this drain
+        if(m_queue.size() > 0 && m_notify && !m_notified.exchange(true)) {
+          m_notify();
+        }
+        return applied;
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_queue.size();
+      }
+
+      [[nodiscard]] size_t capacity() const {
+        return m_queue.capacity();
+      }
+
+      [[nodiscard]] Stats stats() const {
+        return {
+          .pushed = m_pushed.load(std::memory_order_relaxed),
+          .rejected = m_rejected.load(std::memory_order_relaxed),
+          .waits = m_waits.load(std::memory_order_relaxed),
+          .wait_ns = m_wait_ns.load(std::memory_order_relaxed),
+          .applied = m_applied.load(std::memory_order_relaxed),
+          .peak = m_peak.load(std::memory_order_relaxed),
+        };
+      }
+
+    private:
+      static constexpr std::chrono::microseconds MIN_BACKOFF{50};
+      static constexpr std::chrono::microseconds MAX_BACKOFF{2000};
+
+      MpscQueue<Command> m_queue;
+      Notify m_notify;
+      std::thread::id m_consumer;
+      std::atomic<bool> m_notified{false};
+      std::atomic<uint64_t> m_pushed{0};
+      std::atomic<uint64_t> m_rejected{0};
+      std::atomic<uint64_t> m_waits{0};
+      std::atomic<uint64_t> m_wait_ns{0};
+      std::atomic<uint64_t> m_applied{0};
+      std::atomic<size_t> m_peak{0};
+
+      void pushed() {
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+        const auto size = m_queue.size();
+        auto peak = m_peak.load(std::memory_order_relaxed);
+        while(size > peak && !m_peak.compare_exchange_weak(peak, size, std::memory_order_relaxed)) {
+        }
+        if(m_notify && !m_notified.exchange(true)) {
+          m_notify();
+        }
+      }
+  };
+}// namespace mv
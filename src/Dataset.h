@@ -0,0 +1,196 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "ItemLoader.h"
+#include "ItemStore.h"
+#include "ItemStoreFile.h"
+#include "Profiler.h"
+#include "Table.h"
+#include "TrigramIndex.h"
+
+namespace mv {
+  /**
+   * Items, their trigram index and the loader appending to them, shared by every split view window
+   * showing them. Each window keeps its own filter and order, the data exists once however many
+   * windows there are. The windows hold a shared_ptr, the dataset goes away with the last one.
+   *
+   * Items are only appended. Jobs work on ItemStore snapshots, so they see the version of the
+   * items that existed when they were started. fork() makes an independent copy that shares the
+   * item text with this one until one of them appends (see ItemStore).
+   *
+   * A dataset made with a schema also parses the items into rows of its Table, a little every
+   * frame like the index. Views only see the rows parsed so far (rows(), snapshot()).
+   *
+   * The items can be kept in an ItemStoreFile: opening one maps its items instead of loading
+   * them, and items added later are written to it (on its own thread) as chunks fill up.
+   */
+  class Dataset {
+    public:
+      Dataset() = default;
+      explicit Dataset(Schema schema) : m_table(std::make_unique<Table>(std::move(schema))) {}
+
+      Dataset(const Dataset &) = delete;
+      Dataset(Dataset &&) = delete;
+      Dataset &operator=(const Dataset &) = delete;
+      Dataset &operator=(Dataset &&) = delete;
+
+      ~Dataset() {
+        write_file(true);
+      }
+
+      // The items of a store file, written to as more are added. Throws if it can't be opened.
+      static std::shared_ptr<Dataset> open(const std::filesystem::path &path) {
+        auto data = std::make_shared<Dataset>();
+        data->m_file = ItemStoreFile::open(path, data->m_items);
+        spdlog::info("Opened {}: {} items", path.string(), data->m_items.size());
+        return data;
+      }
+
+      // Writes the items to a new store file and keeps it up to date. Throws if it can't be created.
+      void store_in(const std::filesystem::path &path) {
+        m_file = ItemStoreFile::create(path);
+        write_file(true);
+      }
+
+      [[nodiscard]] const ItemStore &items() const {
+        return m_items;
+      }
+
+      [[nodiscard]] const TrigramIndex &index() const {
+        return m_index;
+      }
+
+      // Null for a plain list of items
+      [[nodiscard]] const Table *table() const {
+        return m_table.get();
+      }
+
+      // Null when the items aren't kept in a file
+      [[nodiscard]] const ItemStoreFile *file() const {
+        return m_file.get();
+      }
+
+      [[nodiscard]] ItemLoader *loader() const {
+        return m_loader.get();
+      }
+
+      [[nodiscard]] bool is_loading() const {
+        return m_loader != nullptr;
+      }
+
+      [[nodiscard]] bool is_indexing() const {
+        return m_index.size() < m_items.size();
+      }
+
+      [[nodiscard]] bool is_parsing() const {
+        return m_table && m_table->size() < m_items.size();
+      }
+
+      // Items views can show: all of them, or the ones the table has parsed
+      [[nodiscard]] size_t rows() const {
+        return m_table ? m_table->size() : m_items.size();
+      }
+
+      [[nodiscard]] ItemStore::Snapshot snapshot() const {
+        return m_items.snapshot(rows());
+      }
+
+      void start_loading(std::unique_ptr<ItemLoader> loader) {
+        m_loader = std::move(loader);
+      }
+
+      void append(std::string_view item) {
+        m_items.append(item);
+      }
+
+      template <typename Range>
+      void append_bulk(const Range &items) {
+        m_items.append_bulk(items);
+      }
+
+      // Appends loaded items, parses and indexes new ones. Every window showing the dataset calls this, only
+      // the first call of a frame does something.
+      void update(int frame) {
+        if(frame == m_updated_frame) {
+          return;
+        }
+        MV_PROFILE_SCOPE("Dataset::update");
+        m_updated_frame = frame;
+        update_loader();
+        update_table();
+        write_file(!is_loading());
+        m_index.update(m_items, INDEX_BUDGET);
+      }
+
+      // Same items, not loading, indexed from scratch and not kept in a file
+      [[nodiscard]] std::shared_ptr<Dataset> fork() const {
+        auto copy = std::make_shared<Dataset>();
+        copy->m_items = m_items;
+        if(m_table) {
+          copy->m_table = std::make_unique<Table>(*m_table);
+        }
+        return copy;
+      }
+
+    private:
+      ItemStore m_items{};
+      TrigramIndex m_index{};
+      std::unique_ptr<Table> m_table{};
+      std::unique_ptr<ItemLoader> m_loader{};
+      std::unique_ptr<ItemStoreFile> m_file{};
+      int m_updated_frame{-1};
+
+      // Time per frame spent appending loaded items, the rest of the batches wait for the next frame
+      static constexpr auto LOAD_BUDGET = std::chrono::milliseconds(4);
+      // Same for parsing new items into the table and for indexing them
+      static constexpr auto TABLE_BUDGET = std::chrono::milliseconds(4);
+      static constexpr auto INDEX_BUDGET = std::chrono::milliseconds(4);
+
+      void update_table() {
+        if(m_table && m_table->size() < m_items.size()) {
+          MV_PROFILE_SCOPE("Dataset::update_table");
+          m_table->update(m_items, TABLE_BUDGET);
+        }
+      }
+
+      // While loading only the full chunks are written, the last one is written when it's done. The
+      // file writes on its own thread and logs its errors, a file that failed is let go.
+      void write_file(bool all) {
+        if(!m_file) {
+          return;
+        }
+        if(m_file->failed()) {
+          m_file.reset();
+          return;
+        }
+        m_file->write(m_items, all);
+      }
+
+      void update_loader() {
+        if(!m_loader) {
+          return;
+        }
+        m_loader->drain(m_items, LOAD_BUDGET);
+        if(!m_loader->done()) {
+          return;
+        }
+
+        if(!m_loader->error().empty()) {
+          spdlog::error("Loading {} failed: {}", m_loader->name(), m_loader->error());
+        } else {
+          spdlog::info("{} {}: {} items in {:.2f} s ({:.0f} rows/s)", m_loader->cancelled() ? "Cancelled" : "Loaded", m_loader->name(), m_loader->rows(), m_loader->seconds(), m_loader->rows_per_second());
+        }
+        m_loader.reset();
+      }
+  };
+}// namespace mv
@@ -3,6 +3,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <implot.h>
@@ -11,45 +17,507 @@
 #define UUID_SYSTEM_GENERATOR
 #include <uuid.h>
 
+#include "Application.h"
+#include "DrawStats.h"
+#include "FrameGovernor.h"
+#include "FrameTimeline.h"
+#include "ImGuiUtil.h"
+#include "LatencyHistogram.h"
+#include "MetricSeries.h"
+#include "Profiler.h"
+#include "ThreadPoolStats.h"
 #include "Window.h"
 
 namespace mv {
   class DebugWindow : public Window {
     public:
-      DebugWindow() {
+      explicit DebugWindow(Application &app) : m_app(app) {
         uuids::uuid id = uuids::uuid_system_generator{}();
         m_window_title = "DebugView###" + uuids::to_string(id);
       }
 
       void render() override {
-        auto io = ImGui::GetIO();
-        m_frametime_history.push_back(io.DeltaTime * 1000.0F);// NOLINT
-        if(m_frametime_history.size() > MAX_HISTORY_LENGHT) {
-          m_frametime_history.erase(m_frametime_history.begin(), m_frametime_history.begin() + 1);
-        }
-
+        MV_PROFILE_SCOPE("DebugWindow::render");
         ImGui::SetNextWindowPos(ImVec2(DEFAULT_WINDOW_POS_X, DEFAULT_WINDOW_POS_Y), ImGuiCond_FirstUseEver);
         ImGui::SetNextWindowSize(ImVec2(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT), ImGuiCond_FirstUseEver);
 
-        if(ImGui::Begin(m_window_title.c_str(), &m_is_open, ImGuiWindowFlags_NoSavedSettings)) {
-          if(ImPlot::BeginPlot("Frame time", ImGui::GetContentRegionAvail())) {
-            ImPlot::SetupAxis(ImAxis_Y1, "mS");
-            ImPlot::SetupAxis(ImAxis_X1, "", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_NoLabel | ImPlotAxisFlags_NoTickLabels);
-            ImPlot::PlotLine("##time", m_frametime_history.data(), static_cast<int>(m_frametime_history.size()));
-            ImPlot::EndPlot();
+        if(begin_window(ImGuiWindowFlags_NoSavedSettings)) {
+          if(ImGui::BeginTabBar("##debugtabs")) {
+            if(ImGui::BeginTabItem("Frame time")) {
+              render_frame_time();
+              ImGui::EndTabItem();
+            }
+            if(ImGui::BeginTabItem("Latency")) {
+              render_latency();
+              ImGui::EndTabItem();
+            }
+            if(ImGui::BeginTabItem("Phases")) {
+              render_phases();
+              ImGui::EndTabItem();
+            }
+            if(ImGui::BeginTabItem("Draw data")) {
+              render_draw_stats();
+              ImGui::EndTabItem();
+            }
+            if(ImGui::BeginTabItem("Pacing")) {
+              render_pacing();
+              ImGui::EndTabItem();
+            }
+            if(ImGui::BeginTabItem("Workers")) {
+              render_workers();
+              ImGui::EndTabItem();
+            }
+            ImGui::EndTabBar();
           }
         }
         ImGui::End();
       }
 
+      // The application records the metrics, the plots only need to move while they can be seen
+      [[nodiscard]] bool needs_continuous_redraw() const override {
+        return is_visible();
+      }
+
     private:
-      std::string m_window_title;
-      std::vector<float> m_frametime_history;
+      Application &m_app;
+      FrameTimeStats::Range m_latency_range{FrameTimeStats::LAST_MINUTE};
+      bool m_follow_frame_time{true};
+      // Of the window times plot, kept to reuse the allocations
+      std::vector<WindowHandle> m_window_handles;
+      std::vector<std::string> m_window_labels;
 
-      static constexpr size_t MAX_HISTORY_LENGHT = 500;
+      static constexpr size_t MIN_HISTORY_LENGTH = 100;
+      static constexpr size_t MAX_HISTORY_LENGTH = MetricSeries<float>::MAX_CAPACITY;
       static constexpr float DEFAULT_WINDOW_POS_X = 650.0F;
       static constexpr float DEFAULT_WINDOW_POS_Y = 120.0F;
       static constexpr float DEFAULT_WINDOW_WIDTH = 640.0F;
       static constexpr float DEFAULT_WINDOW_HEIGHT = 480.0F;
+      static constexpr float MAX_TARGET_FPS = 240.0F;
+      static constexpr int MAX_SPIN_THRESHOLD_US = 5000;
+
+      static const char *visibility_name(Window::Visibility visibility) {
+        switch(visibility) {
+        case Window::Visibility::VISIBLE:
+          return "visible";
+        case Window::Visibility::COLLAPSED:
+          return "collapsed";
+        case Window::Visibility::HIDDEN_TAB:
+          return "hidden tab";
+        case Window::Visibility::OFF_SCREEN:
+          return "off-screen";
+        case Window::Visibility::OCCLUDED:
+          return "covered";
+        }
+        return "";
+      }
+
+      template <typename T>
+      static void plot_series(const char *label, const MetricSeries<T> &series) {
+        ImPlot::PlotLineG(
+          label,
+          [](void *data, int idx) {
+            const auto &s = *static_cast<const MetricSeries<T> *>(data);
+            return ImPlotPoint(idx, static_cast<double>(s[static_cast<size_t>(idx)]));
+          },
+          const_cast<MetricSeries<T> *>(&series),// NOLINT: cppcoreguidelines-pro-type-const-cast
+          static_cast<int>(series.size()));
+      }
+
+      // Plots the visible part of the series with at most ~2 points per pixel, each block of the
+      // chosen pyramid level becomes a min and a max point.
+      template <typename T>
+      static void plot_decimated(const char *label, const DecimatedSeries<T> &series) {
+        if(series.size() == 0) {
+          return;
+        }
+        const auto limits = ImPlot::GetPlotLimits();
+        const auto width = static_cast<size_t>(std::max(1.0F, ImPlot::GetPlotSize().x));
+        const auto begin = static_cast<size_t>(std::clamp(std::floor(limits.X.Min), 0.0, static_cast<double>(series.size() - 1)));
+        const auto end = static_cast<size_t>(std::clamp(std::ceil(limits.X.Max) + 1.0, static_cast<double>(begin + 1), static_cast<double>(series.size())));
+        const auto level = series.pick_level(begin, end, width);
+
+        if(level == 0) {
+          struct Raw {
+            const MetricSeries<T> *series;
+            size_t begin;
+          } raw{&series.raw(), begin};
+          ImPlot::PlotLineG(
+            label,
+            [](void *data, int idx) {
+              const auto *r = static_cast<Raw *>(data);
+              const auto index = r->begin + static_cast<size_t>(idx);
+              return ImPlotPoint(static_cast<double>(index), static_cast<double>((*r->series)[index]));
+            },
+            &raw,
+            static_cast<int>(end - begin));
+          return;
+        }
+
+        struct Blocks {
+          const DecimatedSeries<T> *series;
+          size_t level;
+          uint64_t first_block;
+          uint64_t first_sample;
+        } blocks{&series, level, series.sample_number(begin) >> level, series.sample_number(0)};
+        const auto last_block = series.sample_number(end - 1) >> level;
+
+        ImPlot::PlotLineG(
+          label,
+          [](void *data, int idx) {
+            const auto *b = static_cast<Blocks *>(data);
+            const auto block = b->first_block + static_cast<uint64_t>(idx / 2);
+            const auto &range = b->series->block(b->level, block);
+            const auto block_size = static_cast<double>(uint64_t{1} << b->level);
+            const auto x = static_cast<double>(block << b->level) - static_cast<double>(b->first_sample) + (idx % 2 == 0 ? 0.25 : 0.75) * block_size;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+            return ImPlotPoint(x, static_cast<double>(idx % 2 == 0 ? range.min : range.max));
+          },
+          &blocks,
+          static_cast<int>((last_block - blocks.first_block + 1) * 2));
+      }
+
+      void render_frame_time() {
+        auto &series = m_app.frame_time_series();
+
+        // ImGuiDataType_U64 edits the value in place
+        static_assert(sizeof(size_t) == sizeof(uint64_t));
+        size_t history = series.capacity();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        if(ImGui::InputScalar("History (frames)", ImGuiDataType_U64, &history, nullptr, nullptr, nullptr, ImGuiInputTextFlags_EnterReturnsTrue)) {
+          series.set_capacity(std::clamp(history, MIN_HISTORY_LENGTH, MAX_HISTORY_LENGTH));
+        }
+        ImGui::SameLine();
+        ImGui::Checkbox("Follow", &m_follow_frame_time);
+
+        if(ImPlot::BeginPlot("Frame time", ImGui::GetContentRegionAvail())) {
+          ImPlot::SetupAxis(ImAxis_Y1, "mS", ImPlotAxisFlags_AutoFit);
+          ImPlot::SetupAxis(ImAxis_X1, "", ImPlotAxisFlags_NoLabel | ImPlotAxisFlags_NoTickLabels);
+          ImPlot::SetupAxisLimits(ImAxis_X1, 0.0, static_cast<double>(series.size()), m_follow_frame_time ? ImGuiCond_Always : ImGuiCond_Once);
+          plot_decimated("##time", series);
+          ImPlot::EndPlot();
+        }
+      }
+
+      void render_latency() {
+        for(int i = 0; i < FrameTimeStats::RANGE_COUNT; i++) {
+          if(i > 0) {
+            ImGui::SameLine();
+          }
+          if(ImGui::RadioButton(FrameTimeStats::RANGE_NAMES.at(static_cast<size_t>(i)), m_latency_range == i)) {
+            m_latency_range = static_cast<FrameTimeStats::Range>(i);
+          }
+        }
+        if(m_latency_range == FrameTimeStats::SESSION) {
+          ImGui::SameLine();
+          if(ImGui::SmallButton("Reset")) {
+            m_app.frame_time_stats().reset_session();
+          }
+        }
+
+        const auto histogram = m_app.frame_time_stats().histogram(m_latency_range, now_ns());
+        const auto to_ms = [](uint64_t us) { return static_cast<double>(us) / 1000.0; };// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+
+        y44::im_text("{} frames, mean {:.2f} mS", histogram.count(), histogram.mean() / 1000.0);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        y44::im_text("p50 {:.2f}  p90 {:.2f}  p99 {:.2f}  p99.9 {:.2f}  max {:.2f} mS",
+          to_ms(histogram.percentile(0.5)),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          to_ms(histogram.percentile(0.9)),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          to_ms(histogram.percentile(0.99)),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          to_ms(histogram.percentile(0.999)),// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          to_ms(histogram.max()));
+
+        // Only the range of buckets that has samples, x is the lower bound of the bucket in mS
+        size_t first = LatencyHistogram::BUCKET_COUNT;
+        size_t last = 0;
+        for(size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+          if(histogram.bucket_count(i) > 0) {
+            first = std::min(first, i);
+            last = i;
+          }
+        }
+        if(first > last) {
+          return;
+        }
+
+        struct Buckets {
+          const LatencyHistogram *histogram;
+          size_t first;
+        } buckets{&histogram, first};
+
+        if(ImPlot::BeginPlot("Frame time histogram", ImGui::GetContentRegionAvail())) {
+          ImPlot::SetupAxes("mS", "frames", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_LogScale, ImPlotAxisFlags_AutoFit);
+          ImPlot::PlotStairsG(
+            "##histogram",
+            [](void *data, int idx) {
+              const auto *b = static_cast<Buckets *>(data);
+              const auto bucket = b->first + static_cast<size_t>(idx);
+              return ImPlotPoint(static_cast<double>(LatencyHistogram::bucket_lower_bound(bucket)) / 1000.0, static_cast<double>(b->histogram->bucket_count(bucket)));// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+            },
+            &buckets,
+            static_cast<int>(last - first + 1));
+          ImPlot::EndPlot();
+        }
+      }
+
+      // Stacked area per frame phase, the band between the sum of the phases before and the sum
+      // including this one.
+      struct StackedPhase {
+        const FrameTimeline *timeline;
+        int phase;
+      };
+
+      struct StackedWindow {
+        const FrameTimeline *timeline;
+        const std::vector<WindowHandle> *windows;
+        size_t window;
+      };
+
+      static double stacked_window_ms(const FrameRecord &record, const std::vector<WindowHandle> &windows, size_t window_count) {
+        double sum = 0.0;
+        for(size_t i = 0; i < window_count; i++) {
+          sum += static_cast<double>(record.window_ms(windows[i]));
+        }
+        return sum;
+      }
+
+      // Longest update() + render() of the window in the recorded frames
+      static float peak_window_ms(const FrameTimeline &timeline, WindowHandle window) {
+        float peak = 0.0F;
+        for(size_t i = 0; i < timeline.size(); i++) {
+          peak = std::max(peak, timeline.at(i).window_ms(window));
+        }
+        return peak;
+      }
+
+      static double stacked_phase_ms(const FrameRecord &record, int phase_count) {
+        double sum = 0.0;
+        for(int i = 0; i < phase_count; i++) {
+          sum += static_cast<double>(record.phase_ms(static_cast<FramePhase>(i)));
+        }
+        return sum;
+      }
+
+      void render_phases() {
+        const auto &timeline = m_app.frame_timeline();
+        const auto count = static_cast<int>(timeline.size());
+
+        constexpr float TABLE_HEIGHT_LINES = 6.0F;
+        const auto table_height = ImGui::GetTextLineHeightWithSpacing() * TABLE_HEIGHT_LINES;
+        const auto plot_size = ImVec2(-1, std::max((ImGui::GetContentRegionAvail().y - table_height) / 2, table_height));
+
+        if(ImPlot::BeginPlot("Frame phases", plot_size)) {
+          ImPlot::SetupAxes("", "mS", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_NoTickLabels, ImPlotAxisFlags_AutoFit);
+          ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+
+          std::array<StackedPhase, PHASE_COUNT> stacks{};
+          for(int phase = 0; phase < PHASE_COUNT; phase++) {
+            stacks.at(static_cast<size_t>(phase)) = StackedPhase{&timeline, phase};
+            auto *data = &stacks.at(static_cast<size_t>(phase));
+            ImPlot::PlotShadedG(
+              PHASE_NAMES.at(static_cast<size_t>(phase)),
+              [](void *d, int idx) {
+                const auto *stack = static_cast<StackedPhase *>(d);
+                return ImPlotPoint(idx, stacked_phase_ms(stack->timeline->at(static_cast<size_t>(idx)), stack->phase));
+              },
+              data,
+              [](void *d, int idx) {
+                const auto *stack = static_cast<StackedPhase *>(d);
+                return ImPlotPoint(idx, stacked_phase_ms(stack->timeline->at(static_cast<size_t>(idx)), stack->phase + 1));
+              },
+              data,
+              count);
+          }
+          ImPlot::EndPlot();
+        }
+
+        // The open windows stacked in the order they are rendered
+        m_window_handles.clear();
+        m_window_labels.clear();
+        for(const auto &win : m_app.windows()) {
+          m_window_handles.push_back(win->handle());
+          m_window_labels.push_back(fmt::format("{}##{}", win->display_title(), win->handle().index));
+        }
+        if(ImPlot::BeginPlot("Window update() + render()", plot_size)) {
+          ImPlot::SetupAxes("", "mS", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_NoTickLabels, ImPlotAxisFlags_AutoFit);
+          ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+
+          std::vector<StackedWindow> stacks(m_window_handles.size());
+          for(size_t window = 0; window < stacks.size(); window++) {
+            stacks[window] = StackedWindow{&timeline, &m_window_handles, window};
+            ImPlot::PlotShadedG(
+              m_window_labels[window].c_str(),
+              [](void *d, int idx) {
+                const auto *stack = static_cast<StackedWindow *>(d);
+                return ImPlotPoint(idx, stacked_window_ms(stack->timeline->at(static_cast<size_t>(idx)), *stack->windows, stack->window));
+              },
+              &stacks[window],
+              [](void *d, int idx) {
+                const auto *stack = static_cast<StackedWindow *>(d);
+                return ImPlotPoint(idx, stacked_window_ms(stack->timeline->at(static_cast<size_t>(idx)), *stack->windows, stack->window + 1));
+              },
+              &stacks[window],
+              count);
+          }
+          ImPlot::EndPlot();
+        }
+
+        if(ImGui::BeginTable("##windowtimes", 4, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg)) {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          ImGui::TableSetupScrollFreeze(0, 1);
+          ImGui::TableSetupColumn("Window");
+          ImGui::TableSetupColumn("update() + render() mS");
+          ImGui::TableSetupColumn("Peak mS");
+          ImGui::TableSetupColumn("Visibility");
+          ImGui::TableHeadersRow();
+          for(const auto &win : m_app.windows()) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            y44::im_text("{}", win->display_title());
+            ImGui::TableSetColumnIndex(1);
+            y44::im_text("{:.3f}", win->last_render_ms());
+            ImGui::TableSetColumnIndex(2);
+            y44::im_text("{:.3f}", peak_window_ms(timeline, win->handle()));
+            ImGui::TableSetColumnIndex(3);
+            y44::im_text("{}", visibility_name(win->visibility()));
+          }
+          ImGui::EndTable();
+        }
+      }
+
+      void render_draw_stats() {
+        const auto &stats = m_app.draw_stats();
+        const auto &frame = stats.frame();
+        y44::im_text("{} lists, {} draw calls, {} vertices, {} indices", frame.draw_lists, frame.draw_cmds, frame.vertices, frame.indices);
+        y44::im_text("{} texture switches, {} clip rect changes", frame.texture_switches, frame.clip_rect_changes);
+
+        constexpr float TABLE_HEIGHT_LINES = 8.0F;
+        const auto table_height = ImGui::GetTextLineHeightWithSpacing() * TABLE_HEIGHT_LINES;
+        const auto plot_size = ImVec2(-1, std::max(ImGui::GetContentRegionAvail().y - table_height, table_height));
+
+        if(ImPlot::BeginPlot("Geometry", plot_size)) {
+          ImPlot::SetupAxis(ImAxis_X1, "", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_NoLabel | ImPlotAxisFlags_NoTickLabels);
+          ImPlot::SetupAxis(ImAxis_Y1, "vertices / indices", ImPlotAxisFlags_AutoFit);
+          ImPlot::SetupAxis(ImAxis_Y2, "draw calls", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_AuxDefault);
+          ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+          plot_series("Vertices", stats.vertices());
+          plot_series("Indices", stats.indices());
+          ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+          plot_series("Draw calls", stats.draw_cmds());
+          ImPlot::EndPlot();
+        }
+
+        if(ImGui::BeginTable("##drawstats", 7, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          ImGui::TableSetupScrollFreeze(0, 1);
+          ImGui::TableSetupColumn("Window");
+          ImGui::TableSetupColumn("Lists");
+          ImGui::TableSetupColumn("Cmds");
+          ImGui::TableSetupColumn("Vertices");
+          ImGui::TableSetupColumn("Indices");
+          ImGui::TableSetupColumn("Tex");
+          ImGui::TableSetupColumn("Clip");
+          ImGui::TableHeadersRow();
+          for(const auto &win : stats.windows()) {
+            const auto &c = win.counts;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            y44::im_text("{}", win.display_name());
+            for(const auto value : {c.draw_lists, c.draw_cmds, c.vertices, c.indices, c.texture_switches, c.clip_rect_changes}) {
+              ImGui::TableNextColumn();
+              y44::im_text("{}", value);
+            }
+          }
+          ImGui::EndTable();
+        }
+      }
+
+      void render_workers() {
+        const auto &stats = m_app.thread_pool_stats();
+        const auto &workers = stats.workers();
+        y44::im_text("{} workers, {} tasks queued, {} main thread tasks waiting", workers.size(), m_app.thread_pool().queued(), m_app.main_queue().size());
+        if(!stats.mean_utilisation().empty()) {
+          y44::im_text("Utilisation {:.1f} %", stats.mean_utilisation().latest());
+        }
+        const auto &commands = m_app.commands();
+        const auto command_stats = commands.stats();
+        y44::im_text("Commands: {} of {} queued (peak {}), {} applied, {} rejected, {} waited {:.1f} mS",
+          commands.size(),
+          commands.capacity(),
+          command_stats.peak,
+          command_stats.applied,
+          command_stats.rejected,
+          command_stats.waits,
+          static_cast<double>(command_stats.wait_ns) / 1e6);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+
+        constexpr float TABLE_HEIGHT_LINES = 6.0F;
+        const auto table_height = ImGui::GetTextLineHeightWithSpacing() * TABLE_HEIGHT_LINES;
+        const auto plot_size = ImVec2(-1, std::max(ImGui::GetContentRegionAvail().y - table_height, table_height));
+
+        if(ImPlot::BeginPlot("Worker utilisation", plot_size)) {
+          ImPlot::SetupAxis(ImAxis_X1, "", ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_NoLabel | ImPlotAxisFlags_NoTickLabels);
+          ImPlot::SetupAxis(ImAxis_Y1, "%");
+          ImPlot::SetupAxisLimits(ImAxis_Y1, 0.0, 100.0);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+          for(size_t i = 0; i < workers.size(); i++) {
+            plot_series(fmt::format("Worker {}", i).c_str(), workers[i].utilisation);
+          }
+          plot_series("Mean", stats.mean_utilisation());
+          ImPlot::EndPlot();
+        }
+
+        if(ImGui::BeginTable("##workers", 5, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg)) {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          ImGui::TableSetupScrollFreeze(0, 1);
+          ImGui::TableSetupColumn("Worker");
+          ImGui::TableSetupColumn("Busy %");
+          ImGui::TableSetupColumn("Tasks/frame");
+          ImGui::TableSetupColumn("Tasks");
+          ImGui::TableSetupColumn("Stolen");
+          ImGui::TableHeadersRow();
+          for(size_t i = 0; i < workers.size(); i++) {
+            const auto &worker = workers[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            y44::im_text("{}", i);
+            ImGui::TableNextColumn();
+            y44::im_text("{:.1f}", worker.utilisation.empty() ? 0.0F : worker.utilisation.latest());
+            ImGui::TableNextColumn();
+            y44::im_text("{}", worker.tasks);
+            ImGui::TableNextColumn();
+            y44::im_text("{}", worker.totals.tasks);
+            ImGui::TableNextColumn();
+            y44::im_text("{}", worker.totals.steals);
+          }
+          ImGui::EndTable();
+        }
+      }
+
+      void render_pacing() {
+        auto &governor = m_app.frame_governor();
+        const auto &stats = governor.stats();
+
+        y44::im_text("State: {}", FrameGovernor::STATE_NAMES.at(governor.state()));
+        y44::im_text("Frame: {:6.2f} mS (target {:6.2f} mS)", stats.frame_ms, stats.target_ms);
+        y44::im_text("Sleep: {:6.2f} mS  spin: {:6.3f} mS", stats.sleep_ms, stats.spin_ms);
+        y44::im_text("Jitter: {:6.3f} mS avg, {:6.3f} mS max", stats.jitter_ms, stats.max_jitter_ms);
+        if(ImGui::Button("Reset max")) {
+          governor.reset_stats();
+        }
+
+        ImGui::Separator();
+
+        bool vsync = m_app.vsync();
+        if(ImGui::Checkbox("VSync", &vsync)) {
+          m_app.set_vsync(vsync);
+        }
+
+        for(int i = 0; i < FrameGovernor::STATE_COUNT; i++) {
+          const auto state = static_cast<FrameGovernor::State>(i);
+          float fps = governor.target_fps(state);
+          if(ImGui::SliderFloat(fmt::format("{} FPS", FrameGovernor::STATE_NAMES.at(state)).c_str(), &fps, 0.0F, MAX_TARGET_FPS, fps <= 0.0F ? "unlimited" : "%.0f")) {
+            governor.set_target_fps(state, fps);
+          }
+        }
+
+        int spin_us = static_cast<int>(governor.spin_threshold().count());
+        if(ImGui::SliderInt("Spin (uS)", &spin_us, 0, MAX_SPIN_THRESHOLD_US)) {
+          governor.set_spin_threshold(std::chrono::microseconds(spin_us));
+        }
+      }
   };
 }// namespace mv
\ No newline at end of file
@@ -0,0 +1,147 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imgui.h>
+
+#include "MetricSeries.h"
+
+namespace mv {
+  /**
+   * Geometry handed to the renderer backend each frame: draw lists, draw commands, vertices and
+   * indices, plus how often the texture and the clip rect change between consecutive commands.
+   *
+   * Per window numbers are grouped by the root window of each draw list, i.e. child windows count
+   * towards their parent.
+   */
+  class DrawStats {
+    public:
+      struct Counts {
+        int draw_lists{0};
+        int draw_cmds{0};
+        int vertices{0};
+        int indices{0};
+        int texture_switches{0};
+        int clip_rect_changes{0};
+
+        void add(const Counts &other) {
+          draw_lists += other.draw_lists;
+          draw_cmds += other.draw_cmds;
+          vertices += other.vertices;
+          indices += other.indices;
+          texture_switches += other.texture_switches;
+          clip_rect_changes += other.clip_rect_changes;
+        }
+      };
+
+      struct WindowCounts {
+        std::string name;
+        Counts counts;
+
+        [[nodiscard]] std::string_view display_name() const {
+          return std::string_view{name}.substr(0, name.find("###"));
+        }
+      };
+
+      void collect(const ImDrawData *draw_data) {
+        m_frame = Counts{};
+        m_window_count = 0;
+        if(draw_data == nullptr) {
+          return;
+        }
+
+        for(int i = 0; i < draw_data->CmdListsCount; i++) {
+          const auto *list = draw_data->CmdLists[i];// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          const auto counts = count(*list);
+          m_frame.add(counts);
+          window_counts(root_window_name(list->_OwnerName)).add(counts);
+        }
+
+        m_draw_cmds.push(static_cast<float>(m_frame.draw_cmds));
+        m_vertices.push(static_cast<float>(m_frame.vertices));
+        m_indices.push(static_cast<float>(m_frame.indices));
+      }
+
+      [[nodiscard]] const Counts &frame() const {
+        return m_frame;
+      }
+
+      [[nodiscard]] std::span<const WindowCounts> windows() const {
+        return {m_windows.data(), m_window_count};
+      }
+
+      [[nodiscard]] const MetricSeries<float> &draw_cmds() const {
+        return m_draw_cmds;
+      }
+
+      [[nodiscard]] const MetricSeries<float> &vertices() const {
+        return m_vertices;
+      }
+
+      [[nodiscard]] const MetricSeries<float> &indices() const {
+        return m_indices;
+      }
+
+    private:
+      Counts m_frame;
+      // Entries are reused between frames to keep their name allocations, the first m_window_count are valid
+      std::vector<WindowCounts> m_windows;
+      size_t m_window_count{0};
+      MetricSeries<float> m_draw_cmds;
+      MetricSeries<float> m_vertices;
+      MetricSeries<float> m_indices;
+
+      static Counts count(const ImDrawList &list) {
+        Counts counts;
+        counts.draw_lists = 1;
+        counts.draw_cmds = list.CmdBuffer.Size;
+        counts.vertices = list.VtxBuffer.Size;
+        counts.indices = list.IdxBuffer.Size;
+
+        for(int i = 1; i < list.CmdBuffer.Size; i++) {
+          const auto &prev = list.CmdBuffer[i - 1];
+          const auto &cmd = list.CmdBuffer[i];
+          if(cmd.TextureId != prev.TextureId) {
+            ++counts.texture_switches;
+          }
+          if(cmd.ClipRect.x != prev.ClipRect.x || cmd.ClipRect.y != prev.ClipRect.y || cmd.ClipRect.z != prev.ClipRect.z || cmd.ClipRect.w != prev.ClipRect.w) {
+            ++counts.clip_rect_changes;
+          }
+        }
+        return counts;
+      }
+
+      // Child windows are named "Parent/child_ID"
+      static std::string_view root_window_name(const char *owner_name) {
+        if(owner_name == nullptr) {
+          return "(unknown)";
+        }
+        const std::string_view name{owner_name};
+        return name.substr(0, name.find('/'));
+      }
+
+      Counts &window_counts(std::string_view name) {
+        const auto end = m_windows.begin() + static_cast<std::ptrdiff_t>(m_window_count);
+        auto it = std::find_if(m_windows.begin(), end, [name](const WindowCounts &w) { return w.name == name; });
+        if(it != end) {
+          return it->counts;
+        }
+
+        if(m_window_count == m_windows.size()) {
+          m_windows.emplace_back();
+        }
+        auto &entry = m_windows[m_window_count++];
+        entry.name = name;
+        entry.counts = Counts{};
+        return entry.counts;
+      }
+  };
+}// namespace mv
\ No newline at end of file
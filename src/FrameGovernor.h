@@ -0,0 +1,147 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace mv {
+  /**
+   * Frame pacing with a target frame rate per application state.
+   *
+   * wait_for_next_frame() is called once at the end of each frame. It sleeps until shortly
+   * before the deadline and spins for the remaining part, the OS scheduler is too coarse to
+   * hit a deadline with sub-millisecond precision using sleep alone.
+   */
+  class FrameGovernor {
+    public:
+      using clock = std::chrono::steady_clock;
+
+      enum State {
+        FOCUSED,
+        UNFOCUSED,
+        HIDDEN,
+        MINIMIZED,
+        STATE_COUNT
+      };
+
+      struct Stats {
+        float target_ms{0.0F};
+        float frame_ms{0.0F};
+        float jitter_ms{0.0F};// exponential moving average of |frame time - target|
+        float max_jitter_ms{0.0F};
+        float sleep_ms{0.0F};
+        float spin_ms{0.0F};
+      };
+
+      static constexpr std::array<const char *, STATE_COUNT> STATE_NAMES = {"Focused", "Unfocused", "Hidden", "Minimized"};
+
+      void set_state(State state) {
+        m_state = state;
+      }
+
+      [[nodiscard]] State state() const {
+        return m_state;
+      }
+
+      // 0 means unlimited, i.e. only vsync (if enabled) limits the frame rate.
+      void set_target_fps(State state, float fps) {
+        m_target_fps.at(state) = std::max(0.0F, fps);
+      }
+
+      [[nodiscard]] float target_fps(State state) const {
+        return m_target_fps.at(state);
+      }
+
+      void set_spin_threshold(std::chrono::microseconds threshold) {
+        m_spin_threshold = threshold;
+      }
+
+      [[nodiscard]] std::chrono::microseconds spin_threshold() const {
+        return m_spin_threshold;
+      }
+
+      [[nodiscard]] const Stats &stats() const {
+        return m_stats;
+      }
+
+      void reset_stats() {
+        m_stats.max_jitter_ms = 0.0F;
+      }
+
+      void wait_for_next_frame() {
+        const auto fps = m_target_fps.at(m_state);
+        auto now = clock::now();
+
+        if(fps <= 0.0F) {
+          m_stats.sleep_ms = 0.0F;
+          m_stats.spin_ms = 0.0F;
+          m_stats.target_ms = 0.0F;
+          m_deadline = now;
+          record_frame(now, 0.0F);
+          return;
+        }
+
+        const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(1.0F / fps));
+        m_deadline += period;
+
+        // We are more than a frame late (or just switched state), don't try to catch up.
+        if(m_deadline + period < now || m_deadline > now + period) {
+          m_deadline = now + period;
+        }
+
+        const auto sleep_until = m_deadline - m_spin_threshold;
+        if(sleep_until > now) {
+          std::this_thread::sleep_until(sleep_until);
+        }
+        const auto after_sleep = clock::now();
+
+        while(clock::now() < m_deadline) {
+          std::this_thread::yield();
+        }
+        const auto after_spin = clock::now();
+
+        m_stats.sleep_ms = to_ms(after_sleep - now);
+        m_stats.spin_ms = to_ms(after_spin - after_sleep);
+        m_stats.target_ms = to_ms(period);
+        record_frame(after_spin, m_stats.target_ms);
+      }
+
+    private:
+      State m_state{FOCUSED};
+      std::array<float, STATE_COUNT> m_target_fps{DEFAULT_FOCUSED_FPS, DEFAULT_UNFOCUSED_FPS, DEFAULT_HIDDEN_FPS, DEFAULT_MINIMIZED_FPS};
+      std::chrono::microseconds m_spin_threshold{DEFAULT_SPIN_THRESHOLD};
+      clock::time_point m_deadline{clock::now()};
+      clock::time_point m_last_frame{clock::now()};
+      Stats m_stats{};
+
+      static constexpr float DEFAULT_FOCUSED_FPS = 0.0F;
+      static constexpr float DEFAULT_UNFOCUSED_FPS = 30.0F;
+      static constexpr float DEFAULT_HIDDEN_FPS = 10.0F;
+      static constexpr float DEFAULT_MINIMIZED_FPS = 4.0F;
+      static constexpr std::chrono::microseconds DEFAULT_SPIN_THRESHOLD{500};
+      static constexpr float JITTER_SMOOTHING = 0.05F;
+
+      static float to_ms(clock::duration d) {
+        return std::chrono::duration<float, std::milli>(d).count();
+      }
+
+      void record_frame(clock::time_point now, float target_ms) {
+        m_stats.frame_ms = to_ms(now - m_last_frame);
+        m_last_frame = now;
+
+        if(target_ms <= 0.0F) {
+          m_stats.jitter_ms = 0.0F;
+          return;
+        }
+
+        const auto jitter = std::abs(m_stats.frame_ms - target_ms);
+        m_stats.jitter_ms += (jitter - m_stats.jitter_ms) * JITTER_SMOOTHING;
+        m_stats.max_jitter_ms = std::max(m_stats.max_jitter_ms, jitter);
+      }
+  };
+}// namespace mv
\ No newline at end of file
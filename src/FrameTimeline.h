@@ -0,0 +1,168 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "SlotMap.h"
+
+namespace mv {
+  using WindowHandle = SlotKey;
+
+  enum FramePhase {
+    PHASE_EVENTS,
+    PHASE_BEGIN_RENDER,
+    PHASE_WINDOWS,
+    PHASE_IMGUI_RENDER,
+    PHASE_RENDER_DRAW_DATA,
+    PHASE_PRESENT,
+    PHASE_PACING,
+    PHASE_COUNT
+  };
+
+  inline constexpr std::array<const char *, PHASE_COUNT> PHASE_NAMES = {"Events", "Begin render", "Windows", "ImGui::Render", "RenderDrawData", "Present", "Pacing"};
+
+  inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  struct FrameRecord {
+    struct Span {
+      int64_t begin_ns{0};
+      int64_t end_ns{0};
+    };
+
+    // update() + render() of one window
+    struct WindowSpan {
+      WindowHandle window;
+      int64_t begin_ns{0};
+      int64_t end_ns{0};
+    };
+
+    static constexpr size_t MAX_WINDOWS = 16;
+
+    uint64_t frame{0};
+    int64_t begin_ns{0};
+    int64_t end_ns{0};
+    std::array<Span, PHASE_COUNT> phases{};
+    // The first MAX_WINDOWS windows rendered in the frame
+    std::array<WindowSpan, MAX_WINDOWS> windows{};
+    size_t window_count{0};
+
+    [[nodiscard]] float phase_ms(FramePhase phase) const {
+      const auto &span = phases.at(phase);
+      return static_cast<float>(span.end_ns - span.begin_ns) / NS_PER_MS;
+    }
+
+    // 0 when the window wasn't rendered (or recorded) in the frame
+    [[nodiscard]] float window_ms(WindowHandle window) const {
+      for(size_t i = 0; i < window_count; i++) {
+        const auto &span = windows.at(i);
+        if(span.window == window) {
+          return static_cast<float>(span.end_ns - span.begin_ns) / NS_PER_MS;
+        }
+      }
+      return 0.0F;
+    }
+
+    [[nodiscard]] float total_ms() const {
+      return static_cast<float>(end_ns - begin_ns) / NS_PER_MS;
+    }
+
+    static constexpr float NS_PER_MS = 1'000'000.0F;
+  };
+
+  /**
+   * Timestamps of each phase, and of every window's update() + render(), of the last CAPACITY
+   * frames in a fixed size ring buffer.
+   *
+   * A frame is started with begin_frame() and only committed to the ring by end_frame(), frames
+   * that are started but never rendered (reactive mode) simply get overwritten.
+   */
+  class FrameTimeline {
+    public:
+      class ScopedPhase {
+        public:
+          ScopedPhase(FrameTimeline &timeline, FramePhase phase) : m_timeline(timeline), m_phase(phase) {
+            m_timeline.begin_phase(m_phase);
+          }
+          ScopedPhase(const ScopedPhase &) = delete;
+          ScopedPhase(ScopedPhase &&) = delete;
+          ScopedPhase &operator=(const ScopedPhase &) = delete;
+          ScopedPhase &operator=(ScopedPhase &&) = delete;
+
+          ~ScopedPhase() {
+            m_timeline.end_phase(m_phase);
+          }
+
+        private:
+          FrameTimeline &m_timeline;
+          FramePhase m_phase;
+      };
+
+      static constexpr size_t CAPACITY = 1024;
+
+      FrameTimeline() : m_records(CAPACITY) {}
+
+      void begin_frame() {
+        m_current = FrameRecord{};
+        m_current.frame = m_frame_count;
+        m_current.begin_ns = now_ns();
+      }
+
+      void end_frame() {
+        m_current.end_ns = now_ns();
+        m_records[m_head] = m_current;
+        m_head = (m_head + 1) % CAPACITY;
+        m_size = std::min(m_size + 1, CAPACITY);
+        ++m_frame_count;
+      }
+
+      void begin_phase(FramePhase phase) {
+        m_current.phases.at(phase).begin_ns = now_ns();
+      }
+
+      void end_phase(FramePhase phase) {
+        m_current.phases.at(phase).end_ns = now_ns();
+      }
+
+      void record_window(WindowHandle window, int64_t begin_ns, int64_t end_ns) {
+        if(m_current.window_count < FrameRecord::MAX_WINDOWS) {
+          m_current.windows.at(m_current.window_count++) = FrameRecord::WindowSpan{window, begin_ns, end_ns};
+        }
+      }
+
+      [[nodiscard]] ScopedPhase measure(FramePhase phase) {
+        return ScopedPhase{*this, phase};
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_size;
+      }
+
+      [[nodiscard]] uint64_t frame_count() const {
+        return m_frame_count;
+      }
+
+      // 0 is the oldest recorded frame, size() - 1 the latest
+      [[nodiscard]] const FrameRecord &at(size_t index) const {
+        return m_records[(m_head + CAPACITY - m_size + index) % CAPACITY];
+      }
+
+      [[nodiscard]] const FrameRecord &latest() const {
+        return at(m_size - 1);
+      }
+
+    private:
+      std::vector<FrameRecord> m_records;
+      FrameRecord m_current{};
+      size_t m_head{0};
+      size_t m_size{0};
+      uint64_t m_frame_count{0};
+  };
+}// namespace mv
\ No newline at end of file
@@ -0,0 +1,184 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StringMatch.h"
+
+/**
+ * fzf style fuzzy matching: an item matches when it contains the characters of the needle in
+ * order (ASCII case insensitive), with anything in between.
+ *
+ * Like fzf's "v1" algorithm the first match is found with a forward scan, then a backward scan
+ * from its end finds the shortest window ending there. The window is scored with fzf's scheme:
+ * every matched character scores, gaps cost, and characters at word boundaries, camel case humps
+ * and digits (more so the first one) and runs of consecutive characters get a bonus.
+ */
+namespace mv::match {
+  class FuzzyPattern {
+    public:
+      FuzzyPattern() = default;
+      explicit FuzzyPattern(std::string_view needle) : m_needle(needle) {
+        std::transform(m_needle.begin(), m_needle.end(), m_needle.begin(), to_lower);
+      }
+
+      [[nodiscard]] const std::string &needle() const {
+        return m_needle;
+      }
+
+      // Higher is better, nullopt when the text doesn't match. The positions of the matched
+      // characters are appended to positions, pass a reused vector to avoid allocating.
+      [[nodiscard]] std::optional<int> score(std::string_view text, std::vector<uint32_t> *positions = nullptr) const {
+        if(m_needle.empty()) {
+          return 0;
+        }
+
+        // The first window that contains the needle...
+        size_t needle_pos = 0;
+        size_t end = 0;
+        for(size_t i = 0; i < text.size(); i++) {
+          if(to_lower(text[i]) == m_needle[needle_pos] && ++needle_pos == m_needle.size()) {
+            end = i + 1;
+            break;
+          }
+        }
+        if(end == 0) {
+          return std::nullopt;
+        }
+
+        // ...made as short as possible from the back
+        size_t begin = end;
+        needle_pos = m_needle.size();
+        while(needle_pos > 0) {
+          --begin;
+          if(to_lower(text[begin]) == m_needle[needle_pos - 1]) {
+            --needle_pos;
+          }
+        }
+        return score_window(text, begin, end, positions);
+      }
+
+    private:
+      enum CharClass {
+        WHITE,
+        NON_WORD,
+        DELIMITER,
+        LOWER,
+        UPPER,
+        NUMBER
+      };
+
+      static constexpr int SCORE_MATCH = 16;
+      static constexpr int SCORE_GAP_START = -3;
+      static constexpr int SCORE_GAP_EXTENSION = -1;
+      static constexpr int BONUS_BOUNDARY = SCORE_MATCH / 2;
+      static constexpr int BONUS_BOUNDARY_WHITE = BONUS_BOUNDARY + 2;
+      static constexpr int BONUS_BOUNDARY_DELIMITER = BONUS_BOUNDARY + 1;
+      static constexpr int BONUS_NON_WORD = SCORE_MATCH / 2;
+      static constexpr int BONUS_CAMEL_123 = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+      static constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+      static constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+      std::string m_needle;
+
+      static constexpr CharClass char_class(char c) {
+        if(c >= 'a' && c <= 'z') {
+          return LOWER;
+        }
+        if(c >= 'A' && c <= 'Z') {
+          return UPPER;
+        }
+        if(c >= '0' && c <= '9') {
+          return NUMBER;
+        }
+        switch(c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+          return WHITE;
+        case '/':
+        case ',':
+        case ':':
+        case ';':
+        case '|':
+          return DELIMITER;
+        default:
+          // Other bytes of UTF-8 sequences count as letters
+          return (static_cast<unsigned char>(c) & 0x80U) != 0 ? LOWER : NON_WORD;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        }
+      }
+
+      static constexpr int bonus(CharClass previous, CharClass current) {
+        if(current >= LOWER) {
+          switch(previous) {
+          case WHITE:
+            return BONUS_BOUNDARY_WHITE;
+          case DELIMITER:
+            return BONUS_BOUNDARY_DELIMITER;
+          case NON_WORD:
+            return BONUS_BOUNDARY;
+          default:
+            break;
+          }
+        }
+        if((previous == LOWER && current == UPPER) || (previous != NUMBER && current == NUMBER)) {
+          return BONUS_CAMEL_123;
+        }
+        switch(current) {
+        case NON_WORD:
+        case DELIMITER:
+          return BONUS_NON_WORD;
+        case WHITE:
+          return BONUS_BOUNDARY_WHITE;
+        default:
+          return 0;
+        }
+      }
+
+      int score_window(std::string_view text, size_t begin, size_t end, std::vector<uint32_t> *positions) const {
+        int score = 0;
+        int first_bonus = 0;
+        int consecutive = 0;
+        bool in_gap = false;
+        size_t needle_pos = 0;
+        auto previous = begin > 0 ? char_class(text[begin - 1]) : WHITE;
+        for(auto i = begin; i < end; i++) {
+          const auto current = char_class(text[i]);
+          if(needle_pos < m_needle.size() && to_lower(text[i]) == m_needle[needle_pos]) {
+            if(positions != nullptr) {
+              positions->push_back(static_cast<uint32_t>(i));
+            }
+            auto char_bonus = bonus(previous, current);
+            if(consecutive == 0) {
+              first_bonus = char_bonus;
+            } else {
+              // A run keeps the bonus of the boundary it started at
+              if(char_bonus >= BONUS_BOUNDARY && char_bonus > first_bonus) {
+                first_bonus = char_bonus;
+              }
+              char_bonus = std::max({char_bonus, first_bonus, BONUS_CONSECUTIVE});
+            }
+            score += SCORE_MATCH + (needle_pos == 0 ? char_bonus * BONUS_FIRST_CHAR_MULTIPLIER : char_bonus);
+            in_gap = false;
+            ++consecutive;
+            ++needle_pos;
+          } else {
+            score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+          }
+          previous = current;
+        }
+        return score;
+      }
+  };
+}// namespace mv::match
@@ -3,12 +3,16 @@
 
 #pragma once
 
+#include <span>
+#include <string>
 #include <string_view>
 
 #include <fmt/format.h>
 #include <imgui.h>
 #include <imgui_internal.h>
 
+#include "Profiler.h"
+
 inline ImVec2 operator+(const ImVec2 &lhs, const ImVec2 &rhs) noexcept {
   return ImVec2{lhs.x + rhs.x, lhs.y + rhs.y};
 }
@@ -69,14 +73,48 @@ namespace y44 {
     ImGui::Text("%s", text.c_str());// NOLINT
   }
 
-  inline void im_popup_modal(const std::string_view text, const std::string &window_id) {
+  // No formatting and no copy, for large amounts of text such as list items.
+  inline void im_text_unformatted(std::string_view text) {
+    ImGui::TextUnformatted(text.data(), text.data() + text.size());// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+  }
+
+  // Characters [begin, end) of a text, drawn in color
+  struct TextSpan {
+    size_t begin;
+    size_t end;
+    ImU32 color;
+  };
+
+  // Like im_text_unformatted() with the spans (sorted, not overlapping) in their own color. The
+  // pieces are laid out next to each other, nothing is formatted or copied.
+  inline void im_text_spans(std::string_view text, std::span<const TextSpan> spans) {
+    const auto piece = [text](size_t begin, size_t end) {
+      ImGui::TextUnformatted(text.data() + begin, text.data() + end);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+      ImGui::SameLine(0, 0);
+    };
+    size_t pos = 0;
+    for(const auto &span : spans) {
+      if(span.begin > pos) {
+        piece(pos, span.begin);
+      }
+      ImGui::PushStyleColor(ImGuiCol_Text, span.color);
+      piece(span.begin, span.end);
+      ImGui::PopStyleColor();
+      pos = span.end;
+    }
+    im_text_unformatted(text.substr(pos));
+  }
+
+  // Shared by the modal overlays below, centers a borderless window on top of the current window.
+  template <typename Content>
+  inline auto im_overlay(const std::string &window_id, Content &&content) {
     auto parent_pos = ImGui::GetWindowPos();
     auto parent_size = ImGui::GetWindowSize();
 
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(10, 10));// NOLINT:cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
 
     ImGui::Begin(fmt::format("###disabled{}", window_id).c_str(), nullptr, ImGuiWindowFlags_Tooltip | ImGuiWindowFlags_ChildWindow | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_AlwaysUseWindowPadding | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_Modal);
-    im_text("{}", text);
+    auto result = content();
 
     auto popup_size = ImGui::GetWindowSize();
     auto popup_pos = ImVec2((parent_pos.x + parent_size.x / 2) - popup_size.x / 2, (parent_pos.y + parent_size.y / 2) - popup_size.y / 2);
@@ -84,5 +122,31 @@ namespace y44 {
     ImGui::End();
 
     ImGui::PopStyleVar();
+    return result;
+  }
+
+  inline void im_popup_modal(const std::string_view text, const std::string &window_id) {
+    MV_PROFILE_SCOPE("y44::im_popup_modal");
+    im_overlay(window_id, [text] {
+      im_text("{}", text);
+      return true;
+    });
+  }
+
+  // Progress bar with a status line and a Cancel button, a fraction < 0 means the total is unknown.
+  // Returns true when Cancel was clicked.
+  inline bool im_progress_modal(const std::string_view text, float fraction, const std::string_view status, const std::string &window_id) {
+    MV_PROFILE_SCOPE("y44::im_progress_modal");
+    return im_overlay(window_id, [&] {
+      static constexpr float BAR_WIDTH = 300.0F;
+      im_text("{}", text);
+      if(fraction < 0.0F) {
+        ImGui::ProgressBar(0.0F, ImVec2(BAR_WIDTH, 0), "...");
+      } else {
+        ImGui::ProgressBar(fraction, ImVec2(BAR_WIDTH, 0));
+      }
+      im_text("{}", status);
+      return ImGui::Button("Cancel");
+    });
   }
 }// namespace y44
\ No newline at end of file
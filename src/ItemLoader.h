@@ -0,0 +1,308 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "ItemStore.h"
+#include "Profiler.h"
+#include "SpscQueue.h"
+#include "Table.h"
+
+namespace mv {
+  /**
+   * Loads items on a worker thread and hands them to the UI thread in batches.
+   *
+   * The worker produces batches of about BATCH_BYTES of '\n' separated lines and pushes them on a
+   * lock-free queue, the UI thread calls drain() once per frame to append as many batches as fit
+   * in its time budget. When the queue is full the worker backs off, so at most QUEUE_BATCHES
+   * batches are in flight. Nothing on the UI side ever waits for the worker; after cancel() the
+   * worker stops at the next batch and the loader can be dropped once finished() is true.
+   */
+  class ItemLoader {
+    public:
+      static constexpr size_t BATCH_BYTES = 1U << 20U;
+      static constexpr size_t QUEUE_BATCHES = 64;
+
+      // Called on the worker thread after every batch, e.g. to wake up the render loop
+      using Notify = std::function<void()>;
+
+      ItemLoader(const ItemLoader &) = delete;
+      ItemLoader(ItemLoader &&) = delete;
+      ItemLoader &operator=(const ItemLoader &) = delete;
+      ItemLoader &operator=(ItemLoader &&) = delete;
+
+      ~ItemLoader() {
+        cancel();
+        if(m_worker.joinable()) {
+          m_worker.join();
+        }
+      }
+
+      // One item per line, without the header line of a table. Throws if the file can't be opened.
+      static std::unique_ptr<ItemLoader> from_file(const std::filesystem::path &path, Notify notify, bool skip_header = false) {
+        auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+        if(!file->is_open()) {
+          throw std::runtime_error(fmt::format("Could not open {}", path.string()));
+        }
+
+        std::error_code error;
+        const auto size = std::filesystem::file_size(path, error);
+        auto loader = std::unique_ptr<ItemLoader>(new ItemLoader(path.filename().string(), error ? 0 : size, std::move(notify)));
+        loader->start([file, skip_header](ItemLoader &self) { self.read_lines(*file, skip_header); });
+        return loader;
+      }
+
+      // Made up items, for trying out large lists
+      static std::unique_ptr<ItemLoader> from_generator(uint64_t count, Notify notify) {
+        auto loader = std::unique_ptr<ItemLoader>(new ItemLoader(fmt::format("{} generated items", count), count, std::move(notify)));
+        loader->start([count](ItemLoader &self) { self.generate(count); });
+        return loader;
+      }
+
+      // Made up log records with the columns of generated_table_schema()
+      static std::unique_ptr<ItemLoader> from_table_generator(uint64_t count, Notify notify) {
+        auto loader = std::unique_ptr<ItemLoader>(new ItemLoader(fmt::format("{} generated rows", count), count, std::move(notify)));
+        loader->start([count](ItemLoader &self) { self.generate_table(count); });
+        return loader;
+      }
+
+      static Schema generated_table_schema() {
+        return {'\t', {{"id", ColumnType::INT64}, {"time", ColumnType::TIMESTAMP}, {"level", ColumnType::ENUM}, {"latency_ms", ColumnType::DOUBLE}, {"host", ColumnType::ENUM}, {"message", ColumnType::STRING}}};
+      }
+
+      // Appends queued batches until the budget is spent, at least one batch per call. Returns the
+      // number of items added. After cancel() queued batches are thrown away instead.
+      size_t drain(ItemStore &items, std::chrono::nanoseconds budget) {
+        MV_PROFILE_SCOPE("ItemLoader::drain");
+        const auto start = std::chrono::steady_clock::now();
+        const auto size = items.size();
+        std::string batch;
+        while(m_queue.try_pop(batch)) {
+          if(!cancelled()) {
+            items.append_lines(batch);
+          }
+          if(std::chrono::steady_clock::now() - start >= budget) {
+            break;
+          }
+        }
+
+        const auto added = items.size() - size;
+        m_rows += added;
+        if(finished() && m_queue.size() == 0 && m_finished_at == std::chrono::steady_clock::time_point{}) {
+          m_finished_at = std::chrono::steady_clock::now();
+        }
+        return added;
+      }
+
+      void cancel() {
+        m_cancelled.store(true, std::memory_order_relaxed);
+      }
+
+      [[nodiscard]] bool cancelled() const {
+        return m_cancelled.load(std::memory_order_relaxed);
+      }
+
+      // The worker has stopped, there might still be batches left to drain
+      [[nodiscard]] bool finished() const {
+        return m_finished.load(std::memory_order_acquire);
+      }
+
+      // Finished and everything drained
+      [[nodiscard]] bool done() const {
+        return finished() && m_queue.size() == 0;
+      }
+
+      // Set if the worker failed, only valid once finished()
+      [[nodiscard]] const std::string &error() const {
+        return m_error;
+      }
+
+      [[nodiscard]] const std::string &name() const {
+        return m_name;
+      }
+
+      // 0..1, or a negative value when the total isn't known
+      [[nodiscard]] float progress() const {
+        if(m_total == 0) {
+          return finished() ? 1.0F : -1.0F;
+        }
+        return static_cast<float>(static_cast<double>(m_done.load(std::memory_order_relaxed)) / static_cast<double>(m_total));
+      }
+
+      // Items handed to the UI so far
+      [[nodiscard]] uint64_t rows() const {
+        return m_rows;
+      }
+
+      [[nodiscard]] double seconds() const {
+        const auto end = m_finished_at == std::chrono::steady_clock::time_point{} ? std::chrono::steady_clock::now() : m_finished_at;
+        return std::chrono::duration<double>(end - m_started_at).count();
+      }
+
+      [[nodiscard]] double rows_per_second() const {
+        const auto s = seconds();
+        return s > 0.0 ? static_cast<double>(m_rows) / s : 0.0;
+      }
+
+    private:
+      std::string m_name;
+      uint64_t m_total;
+      Notify m_notify;
+      SpscQueue<std::string> m_queue{QUEUE_BATCHES};
+      std::atomic<uint64_t> m_done{0};
+      std::atomic<bool> m_cancelled{false};
+      std::atomic<bool> m_finished{false};
+      std::string m_error;
+      uint64_t m_rows{0};
+      std::chrono::steady_clock::time_point m_started_at{std::chrono::steady_clock::now()};
+      std::chrono::steady_clock::time_point m_finished_at{};
+      std::thread m_worker;
+
+      static constexpr auto BACKOFF = std::chrono::milliseconds(1);
+
+      ItemLoader(std::string name, uint64_t total, Notify notify) : m_name(std::move(name)), m_total(total), m_notify(std::move(notify)) {}
+
+      void start(std::function<void(ItemLoader &)> produce) {
+        m_worker = std::thread([this, produce = std::move(produce)] {
+          MV_PROFILE_THREAD_NAME("loader");
+          try {
+            produce(*this);
+          } catch(const std::exception &e) {
+            m_error = e.what();
+          }
+          m_finished.store(true, std::memory_order_release);
+          if(m_notify) {
+            m_notify();
+          }
+        });
+      }
+
+      // Returns false if cancelled while waiting for room in the queue
+      bool push(std::string &&batch) {
+        while(!m_queue.try_push(std::move(batch))) {
+          if(cancelled()) {
+            return false;
+          }
+          std::this_thread::sleep_for(BACKOFF);
+        }
+        if(m_notify) {
+          m_notify();
+        }
+        return !cancelled();
+      }
+
+      // Batches end on a line break, the partial line at the end of a read is carried over to the next batch
+      void read_lines(std::ifstream &file, bool skip_header) {
+        std::string carry;
+        while(!cancelled()) {
+          MV_PROFILE_SCOPE("ItemLoader::read_lines");
+          std::string batch = std::move(carry);
+          carry.clear();
+          const auto offset = batch.size();
+          batch.resize(offset + BATCH_BYTES);
+          file.read(batch.data() + offset, static_cast<std::streamsize>(BATCH_BYTES));// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          const auto read = static_cast<size_t>(file.gcount());
+          batch.resize(offset + read);
+          m_done.fetch_add(read, std::memory_order_relaxed);
+
+          const bool more = file.good();
+          if(more) {
+            const auto last = batch.rfind('\n');
+            if(last == std::string::npos) {
+              carry = std::move(batch);
+              continue;
+            }
+            carry.assign(batch, last + 1);
+            batch.resize(last + 1);
+          }
+          if(skip_header) {
+            const auto header_end = batch.find('\n');
+            batch.erase(0, header_end == std::string::npos ? batch.size() : header_end + 1);
+            skip_header = false;
+          }
+          if((!batch.empty() && !push(std::move(batch))) || !more) {
+            break;
+          }
+        }
+      }
+
+      static constexpr std::array<std::string_view, 16> WORDS = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa"};
+
+      // xorshift64
+      static uint64_t next_random(uint64_t &state) {
+        state ^= state << 13U;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        state ^= state >> 7U;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        state ^= state << 17U;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        return state;
+      }
+
+      // Pushes batches of the lines line(item, batch) appends
+      template <typename Line>
+      void generate_lines(uint64_t count, Line &&line) {
+        uint64_t item = 0;
+        while(item < count && !cancelled()) {
+          MV_PROFILE_SCOPE("ItemLoader::generate");
+          std::string batch;
+          batch.reserve(BATCH_BYTES + BATCH_BYTES / 16);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          const auto first = item;
+          while(item < count && batch.size() < BATCH_BYTES) {
+            line(item, batch);
+            ++item;
+          }
+          m_done.fetch_add(item - first, std::memory_order_relaxed);
+          if(!push(std::move(batch))) {
+            break;
+          }
+        }
+      }
+
+      void generate(uint64_t count) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        const auto word = [&state] { return WORDS.at(next_random(state) % WORDS.size()); };
+        generate_lines(count, [&word](uint64_t item, std::string &batch) {
+          fmt::format_to(std::back_inserter(batch), "Item {:09} {} {} {}\n", item, word(), word(), word());
+        });
+      }
+
+      void generate_table(uint64_t count) {
+        static constexpr std::array<std::string_view, 4> LEVELS = {"INFO", "DEBUG", "WARN", "ERROR"};
+        static constexpr uint64_t HOSTS = 12;
+        static constexpr int64_t START_US = 1'640'995'200'000'000;// 2022-01-01
+        static constexpr uint64_t MAX_STEP_US = 20'000;
+        static constexpr double LATENCY_SCALE = 1e-4;
+        uint64_t state = 0x9E3779B97F4A7C15ULL;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        int64_t time = START_US;
+        fmt::memory_buffer timestamp;
+        generate_lines(count, [&](uint64_t item, std::string &batch) {
+          time += static_cast<int64_t>(next_random(state) % MAX_STEP_US);
+          timestamp.clear();
+          format_timestamp(timestamp, time);
+          const auto random = next_random(state);
+          // Half of them INFO, fewer of each level after that. Latencies with a long tail.
+          const auto level = LEVELS.at(static_cast<size_t>(std::countr_zero(random | 8U)));// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          const auto latency = static_cast<double>((random >> 8U) % 1000) * static_cast<double>((random >> 20U) % 1000) * LATENCY_SCALE;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+          fmt::format_to(std::back_inserter(batch), "{}\t{}\t{}\t{:.3f}\thost-{:02}\t{} {} {}\n", item, std::string_view{timestamp.data(), timestamp.size()}, level, latency, (random >> 32U) % HOSTS, WORDS.at(random % WORDS.size()), WORDS.at((random >> 4U) % WORDS.size()), WORDS.at((random >> 40U) % WORDS.size()));// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        });
+      }
+  };
+}// namespace mv
@@ -0,0 +1,355 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace mv {
+  /**
+   * Append-only list of strings stored in large contiguous chunks.
+   *
+   * Each chunk holds the text of its items back to back, every item followed by a '\0', and an
+   * array with the offset of each item in the text (plus one past the last item). Compared to a
+   * std::vector<std::string> there is no allocation per item, the per-item overhead is 5 bytes
+   * and a scan over all items walks a few large contiguous buffers.
+   *
+   * Appending never moves existing text or offsets and chunks are reference counted, so a
+   * Snapshot of the items that exist at one point can be read on other threads while the store
+   * keeps growing (or is cleared).
+   *
+   * Copies share the chunks too (structural sharing), copying a store of any size copies one
+   * pointer per chunk. The store a copy was made from keeps appending to its last chunk in place,
+   * beyond the items the copy can see. The copy is not allowed to, its first append copies the
+   * last chunk (copy on write), so both versions can grow independently for the cost of one chunk.
+   *
+   * Chunks can also point into a memory mapped file (see ItemStoreFile), those are read-only and
+   * full, items appended after them go into a new chunk. Their offsets are checked the first time
+   * the chunk is handed out (chunk_of(), Snapshot::chunk()), not when the file is opened.
+   */
+  class ItemStore {
+    public:
+      static constexpr uint32_t CHUNK_TEXT_BYTES = 1U << 20U;
+      static constexpr uint32_t CHUNK_MAX_ITEMS = 1U << 16U;
+
+      class Chunk {
+        public:
+          explicit Chunk(size_t first_item, uint32_t text_capacity)
+            : m_owned_text(std::make_unique<char[]>(text_capacity)),// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+              m_owned_offsets(std::make_unique<uint32_t[]>(CHUNK_MAX_ITEMS + 1)),// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+              m_text(m_owned_text.get()),
+              m_offsets(m_owned_offsets.get()),
+              m_text_capacity(text_capacity),
+              m_first_item(first_item) {
+          }
+
+          // The first count items of source, with room for more
+          Chunk(const Chunk &source, uint32_t count) : Chunk(source.m_first_item, std::max(source.m_text_capacity, CHUNK_TEXT_BYTES)) {
+            m_text_size = source.m_offsets[count];
+            m_count = count;
+            std::memcpy(m_owned_text.get(), source.m_text, m_text_size);
+            std::memcpy(m_owned_offsets.get(), source.m_offsets, (count + 1) * sizeof(uint32_t));
+          }
+
+          // count items whose text and offsets are in memory that mapping keeps mapped
+          Chunk(size_t first_item, std::shared_ptr<const void> mapping, const char *text, const uint32_t *offsets, uint32_t count)
+            : m_mapping(std::move(mapping)),
+              m_text(text),
+              m_offsets(offsets),
+              m_text_capacity(offsets[count]),// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+              m_text_size(offsets[count]),// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+              m_count(count),
+              m_first_item(first_item) {
+          }
+
+          [[nodiscard]] bool is_mapped() const {
+            return m_mapping != nullptr;
+          }
+
+          // Offsets that don't start at 0, grow by at least one (the '\0') per item and end at the
+          // text size would read outside the mapping, the items of such a chunk are left empty
+          void check() {
+            if(is_mapped()) {
+              std::call_once(m_checked, [this] {
+                const auto offsets = std::span{m_offsets, m_count + 1};
+                if(offsets.front() != 0 || offsets.back() != m_text_size || std::adjacent_find(offsets.begin(), offsets.end(), std::greater_equal<>{}) != offsets.end()) {
+                  spdlog::error("Damaged offsets in the mapped items {} to {}, they are left empty", m_first_item, m_first_item + m_count);
+                  clear_items();
+                }
+              });
+            }
+          }
+
+          [[nodiscard]] size_t first_item() const {
+            return m_first_item;
+          }
+
+          [[nodiscard]] uint32_t size() const {
+            return m_count;
+          }
+
+          // All items of the chunk, '\0' separated
+          [[nodiscard]] std::string_view text() const {
+            return {m_text, m_text_size};
+          }
+
+          [[nodiscard]] std::span<const uint32_t> offsets() const {
+            return {m_offsets, m_count + 1};
+          }
+
+          // Text and offsets of the first count items, these are never written again and can be
+          // read while items are appended
+          [[nodiscard]] std::string_view text(uint32_t count) const {
+            return {m_text, m_offsets[count]};// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          }
+
+          [[nodiscard]] std::span<const uint32_t> offsets(uint32_t count) const {
+            return {m_offsets, count + 1};
+          }
+
+          [[nodiscard]] std::string_view operator[](uint32_t index) const {
+            const auto *offsets = m_offsets;
+            return {m_text + offsets[index], offsets[index + 1] - offsets[index] - 1};// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          }
+
+          [[nodiscard]] bool fits(size_t length) const {
+            return !is_mapped() && m_count < CHUNK_MAX_ITEMS && m_text_size + length + 1 <= m_text_capacity;
+          }
+
+          void append(std::string_view item) {
+            assert(fits(item.size()));
+            std::memcpy(m_owned_text.get() + m_text_size, item.data(), item.size());// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+            m_text_size += static_cast<uint32_t>(item.size());
+            m_owned_text[m_text_size++] = '\0';
+            m_owned_offsets[++m_count] = m_text_size;
+          }
+
+          // Mapped chunks count as nothing, the pages belong to the file
+          [[nodiscard]] size_t memory_usage() const {
+            return sizeof(Chunk) + (is_mapped() ? 0 : m_text_capacity + (CHUNK_MAX_ITEMS + 1) * sizeof(uint32_t));
+          }
+
+        private:
+          // Keeps the count with empty text, every item a '\0'
+          void clear_items() {
+            m_owned_text = std::make_unique<char[]>(m_count);// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+            m_owned_offsets = std::make_unique<uint32_t[]>(m_count + 1);// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+            for(uint32_t i = 0; i <= m_count; i++) {
+              m_owned_offsets[i] = i;
+            }
+            m_text = m_owned_text.get();
+            m_offsets = m_owned_offsets.get();
+            m_text_capacity = m_count;
+            m_text_size = m_count;
+          }
+
+          std::unique_ptr<char[]> m_owned_text;// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+          std::unique_ptr<uint32_t[]> m_owned_offsets;// NOLINT: cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays
+          std::shared_ptr<const void> m_mapping;
+          const char *m_text;
+          const uint32_t *m_offsets;
+          uint32_t m_text_capacity;
+          uint32_t m_text_size{0};
+          uint32_t m_count{0};
+          size_t m_first_item;
+          std::once_flag m_checked;
+      };
+
+      /**
+       * The items of a store at the time the snapshot was taken, for reading on other threads.
+       */
+      class Snapshot {
+        public:
+          [[nodiscard]] size_t size() const {
+            return m_size;
+          }
+
+          [[nodiscard]] size_t chunk_count() const {
+            return m_chunks.size();
+          }
+
+          [[nodiscard]] const Chunk &chunk(size_t index) const {
+            m_chunks[index]->check();
+            return *m_chunks[index];
+          }
+
+          // Items of the chunk that are part of the snapshot
+          [[nodiscard]] uint32_t chunk_size(size_t index) const {
+            return m_counts[index];
+          }
+
+          [[nodiscard]] size_t chunk_index_of(size_t item) const {
+            assert(item < m_size);
+            const auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), item, [](size_t i, const std::shared_ptr<Chunk> &chunk) { return i < chunk->first_item(); });
+            return static_cast<size_t>(it - m_chunks.begin()) - 1;
+          }
+
+          [[nodiscard]] std::string_view operator[](size_t item) const {
+            const auto &chunk = this->chunk(chunk_index_of(item));
+            return chunk[static_cast<uint32_t>(item - chunk.first_item())];
+          }
+
+        private:
+          friend class ItemStore;
+
+          // Not const, check() fills in damaged mapped chunks
+          std::vector<std::shared_ptr<Chunk>> m_chunks;
+          std::vector<uint32_t> m_counts;
+          size_t m_size{0};
+      };
+
+      ItemStore() = default;
+      ~ItemStore() = default;
+
+      ItemStore(const ItemStore &other) : m_chunks(other.m_chunks), m_size(other.m_size) {}
+
+      ItemStore(ItemStore &&other) noexcept
+        : m_chunks(std::move(other.m_chunks)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_owns_tail(std::exchange(other.m_owns_tail, false)) {
+      }
+
+      ItemStore &operator=(const ItemStore &other) {
+        if(this != &other) {
+          m_chunks = other.m_chunks;
+          m_size = other.m_size;
+          m_owns_tail = false;
+        }
+        return *this;
+      }
+
+      ItemStore &operator=(ItemStore &&other) noexcept {
+        m_chunks = std::move(other.m_chunks);
+        m_size = std::exchange(other.m_size, 0);
+        m_owns_tail = std::exchange(other.m_owns_tail, false);
+        return *this;
+      }
+
+      void append(std::string_view item) {
+        if(m_chunks.empty() || !m_chunks.back()->fits(item.size())) {
+          m_chunks.push_back(std::make_shared<Chunk>(m_size, static_cast<uint32_t>(std::max<size_t>(CHUNK_TEXT_BYTES, item.size() + 1))));
+          m_owns_tail = true;
+        } else if(!m_owns_tail) {
+          // Shared with the store this one was copied from, which may have appended to it since
+          const auto &tail = *m_chunks.back();
+          m_chunks.back() = std::make_shared<Chunk>(tail, static_cast<uint32_t>(m_size - tail.first_item()));
+          m_owns_tail = true;
+        }
+        m_chunks.back()->append(item);
+        ++m_size;
+      }
+
+      // Items that are already in a chunk, such as one read from a file. Nothing is appended to it.
+      void append_chunk(std::shared_ptr<Chunk> chunk) {
+        assert(chunk->first_item() == m_size);
+        m_size += chunk->size();
+        m_chunks.push_back(std::move(chunk));
+        m_owns_tail = false;
+      }
+
+      template <typename Range>
+      void append_bulk(const Range &items) {
+        for(const auto &item : items) {
+          append(std::string_view{item});
+        }
+      }
+
+      // Appends every line of text, '\r' before the '\n' is dropped and so is a trailing empty line
+      void append_lines(std::string_view text) {
+        while(!text.empty()) {
+          const auto end = text.find('\n');
+          auto line = text.substr(0, end);
+          if(!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+          }
+          append(line);
+          if(end == std::string_view::npos) {
+            break;
+          }
+          text.remove_prefix(end + 1);
+        }
+      }
+
+      void clear() {
+        m_chunks.clear();
+        m_size = 0;
+        m_owns_tail = false;
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_size;
+      }
+
+      [[nodiscard]] bool empty() const {
+        return m_size == 0;
+      }
+
+      [[nodiscard]] std::string_view operator[](size_t index) const {
+        const auto &chunk = chunk_of(index);
+        return chunk[static_cast<uint32_t>(index - chunk.first_item())];
+      }
+
+      [[nodiscard]] const Chunk &chunk_of(size_t index) const {
+        auto &chunk = *m_chunks[chunk_index_of(index)];
+        chunk.check();
+        return chunk;
+      }
+
+      [[nodiscard]] size_t chunk_index_of(size_t index) const {
+        assert(index < m_size);
+        const auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), index, [](size_t i, const std::shared_ptr<Chunk> &chunk) { return i < chunk->first_item(); });
+        return static_cast<size_t>(it - m_chunks.begin()) - 1;
+      }
+
+      // The last chunk of a copied store can hold more items than the store has, use size()
+      [[nodiscard]] const std::vector<std::shared_ptr<Chunk>> &chunks() const {
+        return m_chunks;
+      }
+
+      [[nodiscard]] Snapshot snapshot() const {
+        return snapshot(m_size);
+      }
+
+      // Of the first size items only
+      [[nodiscard]] Snapshot snapshot(size_t size) const {
+        assert(size <= m_size);
+        const auto last = size == m_size ? m_chunks.end() : std::lower_bound(m_chunks.begin(), m_chunks.end(), size, [](const std::shared_ptr<Chunk> &chunk, size_t i) { return chunk->first_item() < i; });
+        Snapshot snapshot;
+        snapshot.m_chunks = {m_chunks.begin(), last};
+        snapshot.m_counts.reserve(snapshot.m_chunks.size());
+        for(size_t i = 0; i < snapshot.m_chunks.size(); i++) {
+          const auto end = i + 1 < snapshot.m_chunks.size() ? m_chunks[i + 1]->first_item() : size;
+          snapshot.m_counts.push_back(static_cast<uint32_t>(end - m_chunks[i]->first_item()));
+        }
+        snapshot.m_size = size;
+        return snapshot;
+      }
+
+      // Allocated bytes including unused chunk capacity
+      [[nodiscard]] size_t memory_usage() const {
+        size_t bytes = sizeof(ItemStore) + m_chunks.capacity() * sizeof(std::shared_ptr<Chunk>);
+        for(const auto &chunk : m_chunks) {
+          bytes += chunk->memory_usage();
+        }
+        return bytes;
+      }
+
+    private:
+      std::vector<std::shared_ptr<Chunk>> m_chunks;
+      size_t m_size{0};
+      // Whether appending to the last chunk in place is allowed, see the class comment
+      bool m_owns_tail{false};
+  };
+}// namespace mv
\ No newline at end of file
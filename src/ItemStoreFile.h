@@ -0,0 +1,328 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "ItemStore.h"
+#include "Profiler.h"
+
+namespace mv {
+  /**
+   * An ItemStore on disk, opened with mmap so a store of any size is there right away and its
+   * pages are only read when items are looked at.
+   *
+   * The file is a header followed by blocks, one per part of a chunk that was written. A block is
+   * laid out like a chunk in memory: a block header, the item offsets (count + 1 of them, relative
+   * to the block text) and the '\0' separated text, padded to BLOCK_ALIGNMENT. Every block becomes
+   * a mapped chunk when the file is opened, nothing is copied. Opening only checks the block
+   * headers and the first and last offset of each block, the chunk checks the rest when it's
+   * first used (see ItemStore).
+   *
+   * Blocks are only ever appended, write() hands the items the file doesn't have yet to a worker
+   * thread, the UI thread never waits for the disk. A block that was cut short (the application
+   * died while writing it) is dropped and overwritten by the next write. Numbers are stored in the
+   * byte order of the machine that wrote them.
+   *
+   * The file is locked (flock) while it's open, a second ItemStoreFile for it can't be made, in
+   * this process or another one.
+   */
+  class ItemStoreFile {
+    public:
+      static constexpr std::string_view EXTENSION = ".mvstore";
+
+      ItemStoreFile(const ItemStoreFile &) = delete;
+      ItemStoreFile(ItemStoreFile &&) = delete;
+      ItemStoreFile &operator=(const ItemStoreFile &) = delete;
+      ItemStoreFile &operator=(ItemStoreFile &&) = delete;
+
+      // Pending writes are finished before the thread exits
+      ~ItemStoreFile() {
+        {
+          const std::scoped_lock lock(m_mutex);
+          m_should_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+        close(m_lock);
+      }
+
+      // Creates (or empties) the file at path
+      static std::unique_ptr<ItemStoreFile> create(const std::filesystem::path &path) {
+        auto file = std::unique_ptr<ItemStoreFile>(new ItemStoreFile(path, lock(path, O_RDONLY | O_CREAT), 0));
+        file->m_out.open(path, std::ios::binary | std::ios::trunc);
+        if(!file->m_out.is_open()) {
+          throw std::runtime_error(fmt::format("Could not create {}", path.string()));
+        }
+        const FileHeader header{};
+        file->m_out.write(reinterpret_cast<const char *>(&header), sizeof(header));// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast
+        file->m_out.flush();
+        return file;
+      }
+
+      // Maps the items of the file at path into items, which must be empty. Items appended to it
+      // later are written after them. Throws if the file can't be opened or isn't a store file.
+      static std::unique_ptr<ItemStoreFile> open(const std::filesystem::path &path, ItemStore &items) {
+        MV_PROFILE_SCOPE("ItemStoreFile::open");
+        assert(items.empty());
+        const int locked = lock(path, O_RDONLY);
+        std::shared_ptr<const Mapping> mapping;
+        try {
+          mapping = map(path);
+        } catch(...) {
+          close(locked);
+          throw;
+        }
+        auto file = std::unique_ptr<ItemStoreFile>(new ItemStoreFile(path, locked, 0));
+        const auto *data = static_cast<const char *>(mapping->data);
+        const auto size = mapping->size;
+        if(size < sizeof(FileHeader) || std::memcmp(data, FileHeader{}.magic.data(), FileHeader{}.magic.size()) != 0) {
+          throw std::runtime_error(fmt::format("{} is not an item store file", path.string()));
+        }
+
+        size_t pos = sizeof(FileHeader);
+        while(pos + sizeof(BlockHeader) <= size) {
+          BlockHeader block{};
+          std::memcpy(&block, data + pos, sizeof(block));// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          const auto block_size = block_bytes(block.count, block.text_size);
+          if(block.magic != BlockHeader{}.magic || block.count == 0 || block.count > ItemStore::CHUNK_MAX_ITEMS || block_size > size - pos) {
+            break;
+          }
+          const auto *offsets = reinterpret_cast<const uint32_t *>(data + pos + sizeof(BlockHeader));// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+          const auto *text = reinterpret_cast<const char *>(offsets + block.count + 1);// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+          if(offsets[0] != 0 || offsets[block.count] != block.text_size) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+            break;
+          }
+          items.append_chunk(std::make_shared<ItemStore::Chunk>(items.size(), mapping, text, offsets, block.count));
+          pos += block_size;
+        }
+        if(pos < size) {
+          spdlog::warn("{}: dropping {} bytes after the last complete block", path.string(), size - pos);
+          std::filesystem::resize_file(path, pos);
+        }
+
+        file->m_written = items.size();
+        file->m_queued = items.size();
+        file->m_out.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+        if(!file->m_out.is_open()) {
+          throw std::runtime_error(fmt::format("Could not open {} for writing", path.string()));
+        }
+        return file;
+      }
+
+      [[nodiscard]] const std::filesystem::path &path() const {
+        return m_path;
+      }
+
+      // Items in the file, written by the worker so far
+      [[nodiscard]] size_t size() const {
+        return m_written.load(std::memory_order_acquire);
+      }
+
+      // Set when writing failed (and was logged), nothing more is written then
+      [[nodiscard]] bool failed() const {
+        return m_failed.load(std::memory_order_acquire);
+      }
+
+      // Has the worker append the items of the store the file doesn't have yet, the ones in the
+      // last chunk only if all is set. The last chunk usually gets more items, waiting saves a
+      // block per frame. A snapshot is handed over, the store can keep growing meanwhile.
+      void write(const ItemStore &items, bool all) {
+        const auto &chunks = items.chunks();
+        if(chunks.empty()) {
+          return;
+        }
+        const auto end = all ? items.size() : chunks.back()->first_item();
+        if(end <= m_queued) {
+          return;
+        }
+        m_queued = end;
+        {
+          const std::scoped_lock lock(m_mutex);
+          m_pending = items.snapshot(end);
+        }
+        m_cv.notify_one();
+      }
+
+    private:
+      static constexpr size_t BLOCK_ALIGNMENT = 8;
+
+      struct FileHeader {
+        std::array<char, 8> magic{'M', 'V', 'S', 'T', 'O', 'R', 'E', '1'};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      };
+
+      struct BlockHeader {
+        uint32_t magic{0x4B4C4256};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        uint32_t count{0};
+        uint32_t text_size{0};
+        uint32_t reserved{0};
+      };
+
+      struct Mapping {
+        void *data{nullptr};
+        size_t size{0};
+
+        Mapping(void *mapped, size_t bytes) : data(mapped), size(bytes) {}
+        Mapping(const Mapping &) = delete;
+        Mapping(Mapping &&) = delete;
+        Mapping &operator=(const Mapping &) = delete;
+        Mapping &operator=(Mapping &&) = delete;
+        ~Mapping() {
+          if(size > 0) {
+            munmap(data, size);
+          }
+        }
+      };
+
+      std::filesystem::path m_path;
+      // Descriptor holding the flock
+      int m_lock;
+      // Items handed to the worker, UI thread only
+      size_t m_queued;
+      std::atomic<size_t> m_written;
+      std::atomic<bool> m_failed{false};
+      // The worker's, once it's started
+      std::ofstream m_out;
+      // Offsets of the block being written, relative to its text
+      std::vector<uint32_t> m_offsets;
+      std::mutex m_mutex;
+      std::condition_variable m_cv;
+      // Only the latest items are kept, they include the ones of an earlier write()
+      std::optional<ItemStore::Snapshot> m_pending;
+      bool m_should_stop{false};
+      std::thread m_thread;// last, the worker uses the members above
+
+      ItemStoreFile(std::filesystem::path path, int locked, size_t written)
+        : m_path(std::move(path)), m_lock(locked), m_queued(written), m_written(written), m_thread([this] { worker(); }) {}
+
+      // Opens path and takes an exclusive flock on it, throws if it's locked already
+      static int lock(const std::filesystem::path &path, int flags) {
+        static constexpr mode_t MODE = 0644;
+        const int fd = ::open(path.c_str(), flags, MODE);// NOLINT: cppcoreguidelines-pro-type-vararg,hicpp-vararg
+        if(fd < 0) {
+          throw std::runtime_error(fmt::format("Could not open {}: {}", path.string(), std::strerror(errno)));
+        }
+        if(flock(fd, LOCK_EX | LOCK_NB) != 0) {
+          const auto error = errno;
+          close(fd);
+          throw std::runtime_error(error == EWOULDBLOCK ? fmt::format("{} is already open", path.string()) : fmt::format("Could not lock {}: {}", path.string(), std::strerror(error)));
+        }
+        return fd;
+      }
+
+      void worker() {
+        MV_PROFILE_THREAD_NAME("store writer");
+        while(true) {
+          ItemStore::Snapshot items;
+          {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_should_stop || m_pending; });
+            if(!m_pending) {
+              return;
+            }
+            items = std::move(*m_pending);
+            m_pending.reset();
+          }
+          if(failed()) {
+            continue;
+          }
+          try {
+            write_items(items);
+          } catch(const std::exception &e) {
+            spdlog::error("{}, no longer writing to it", e.what());
+            m_failed.store(true, std::memory_order_release);
+          }
+        }
+      }
+
+      // The items of the snapshot the file doesn't have yet, throws if writing fails
+      void write_items(const ItemStore::Snapshot &items) {
+        auto written = m_written.load(std::memory_order_relaxed);
+        if(written >= items.size()) {
+          return;
+        }
+        MV_PROFILE_SCOPE("ItemStoreFile::write");
+        for(auto index = items.chunk_index_of(written); index < items.chunk_count(); index++) {
+          const auto &chunk = items.chunk(index);
+          const auto end = items.chunk_size(index);
+          write_block(chunk, static_cast<uint32_t>(written - chunk.first_item()), end);
+          written = chunk.first_item() + end;
+        }
+        m_out.flush();
+        if(!m_out) {
+          throw std::runtime_error(fmt::format("Could not write {}", m_path.string()));
+        }
+        m_written.store(written, std::memory_order_release);
+      }
+
+      static size_t block_bytes(uint32_t count, uint32_t text_size) {
+        const auto bytes = sizeof(BlockHeader) + (size_t{count} + 1) * sizeof(uint32_t) + text_size;
+        return (bytes + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+      }
+
+      // The whole file, read-only. The mapping stays valid after the descriptor is closed.
+      static std::shared_ptr<const Mapping> map(const std::filesystem::path &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);// NOLINT: cppcoreguidelines-pro-type-vararg,hicpp-vararg
+        if(fd < 0) {
+          throw std::runtime_error(fmt::format("Could not open {}: {}", path.string(), std::strerror(errno)));
+        }
+        struct stat info {};
+        if(fstat(fd, &info) != 0) {
+          const auto error = errno;
+          close(fd);
+          throw std::runtime_error(fmt::format("Could not open {}: {}", path.string(), std::strerror(error)));
+        }
+        const auto size = static_cast<size_t>(info.st_size);
+        void *data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        const auto error = errno;
+        close(fd);
+        if(data == MAP_FAILED) {// NOLINT: cppcoreguidelines-pro-type-cstyle-cast
+          throw std::runtime_error(fmt::format("Could not map {}: {}", path.string(), std::strerror(error)));
+        }
+        return std::make_shared<const Mapping>(data, size);
+      }
+
+      // Items [begin, end) of a chunk
+      void write_block(const ItemStore::Chunk &chunk, uint32_t begin, uint32_t end) {
+        const auto offsets = chunk.offsets(end);
+        const auto base = offsets[begin];
+        m_offsets.assign(offsets.begin() + begin, offsets.end());
+        std::for_each(m_offsets.begin(), m_offsets.end(), [base](uint32_t &offset) { offset -= base; });
+
+        const BlockHeader header{.count = end - begin, .text_size = offsets[end] - base};
+        const auto text = chunk.text(end).substr(base);
+        const std::array<char, BLOCK_ALIGNMENT> padding{};
+        m_out.write(reinterpret_cast<const char *>(&header), sizeof(header));// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast
+        m_out.write(reinterpret_cast<const char *>(m_offsets.data()), static_cast<std::streamsize>(m_offsets.size() * sizeof(uint32_t)));// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast
+        m_out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        m_out.write(padding.data(), static_cast<std::streamsize>(block_bytes(header.count, header.text_size) - sizeof(header) - m_offsets.size() * sizeof(uint32_t) - text.size()));
+      }
+  };
+}// namespace mv
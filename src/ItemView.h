@@ -0,0 +1,614 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Dataset.h"
+#include "FuzzyMatch.h"
+#include "ItemStore.h"
+#include "Profiler.h"
+#include "StringMatch.h"
+#include "Table.h"
+#include "ThreadPool.h"
+#include "TrigramIndex.h"
+
+namespace mv {
+  enum class SortOrder {
+    NONE,
+    ASCENDING,
+    DESCENDING
+  };
+
+  /**
+   * The rows of an item list: the items that contain a query (ASCII case insensitive, or start
+   * with it if the query starts with '^'), optionally sorted.
+   *
+   * Filtering and sorting run as jobs on the thread pool, over a snapshot of the store, and
+   * produce a vector of item ids. The last finished result stays on screen until the next job is
+   * done, starting a job cancels the one still running. Items appended later are filtered by a
+   * job of their own and merged into the result.
+   *
+   * A new query starts from the trigram index candidates, when the query was extended only the
+   * previous result is filtered again (whichever is fewer).
+   *
+   * A fuzzy query ranks the matching items by score instead, each part of the scan keeps a heap
+   * of its best FUZZY_TOP_K items and only those are merged and shown. A sort order sorts them.
+   *
+   * Items of a dataset with a table are sorted by the values of one of its columns, the filter
+   * still matches the whole item.
+   */
+  class ItemView {
+    public:
+      static constexpr size_t FUZZY_TOP_K = 10'000;
+
+      void set_query(std::string_view query, bool fuzzy, const Dataset &data, ThreadPool &pool) {
+        const bool filtered = !query.empty();
+        fuzzy = fuzzy && filtered;
+        const bool prefix = !fuzzy && query.starts_with('^');
+        match::Pattern pattern{fuzzy ? std::string_view{} : (prefix ? query.substr(1) : query), true, prefix};
+        match::FuzzyPattern fuzzy_pattern{fuzzy ? query : std::string_view{}};
+        if(filtered == m_filtered && fuzzy == m_fuzzy && pattern.needle() == m_pattern.needle() && prefix == m_pattern.prefix() && fuzzy_pattern.needle() == m_fuzzy_pattern.needle()) {
+          return;
+        }
+        MV_PROFILE_SCOPE("ItemView::set_query");
+        m_pattern = std::move(pattern);
+        m_fuzzy_pattern = std::move(fuzzy_pattern);
+        m_filtered = filtered;
+        m_fuzzy = fuzzy;
+        if(m_fuzzy) {
+          start(FULL, data, pool);
+          return;
+        }
+
+        // Every match of the new query is in the current result
+        const auto &base = *m_result;
+        const auto &index = data.index();
+        const bool refine = m_filtered && base.filtered && !base.fuzzy && same_order(base) && extends(m_pattern, base.pattern);
+        const auto bound = m_filtered ? index.candidate_bound(m_pattern.needle()) : std::nullopt;
+        if(refine && (!selective(bound, index) || *bound >= base.rows.size())) {
+          start(REFINE, data, pool);
+        } else {
+          start(FULL, data, pool);
+        }
+      }
+
+      // column is a column of the table, ignored for a dataset without one
+      void set_order(SortOrder order, size_t column, const Dataset &data, ThreadPool &pool) {
+        if(order == m_order && column == m_column) {
+          return;
+        }
+        m_order = order;
+        m_column = column;
+        // Same filter, only the rows have to be sorted again
+        start(!m_result->all && same_filter(*m_result) ? TAIL : FULL, data, pool);
+      }
+
+      // Picks up the result of a finished job, and starts a job for the items appended since
+      void update(const Dataset &data, ThreadPool &pool) {
+        if(m_job && m_job->done.load(std::memory_order_acquire)) {
+          m_result = std::move(m_job->result);
+          m_job.reset();
+        }
+        if(!m_job && !m_result->all && m_result->covered < data.rows()) {
+          start(TAIL, data, pool);
+        }
+      }
+
+      // Switched to another dataset, keeps the query and the order
+      void reset(const Dataset &data, ThreadPool &pool) {
+        cancel();
+        m_result = std::make_shared<Result>();
+        start(FULL, data, pool);
+      }
+
+      // Filtered or sorted, also while the first job is running
+      [[nodiscard]] bool active() const {
+        return m_filtered || m_order != SortOrder::NONE;
+      }
+
+      [[nodiscard]] bool busy() const {
+        return m_job != nullptr;
+      }
+
+      [[nodiscard]] SortOrder order() const {
+        return m_order;
+      }
+
+      // Number of rows on screen, the matches (so far) or all items
+      [[nodiscard]] size_t size(const ItemStore &items) const {
+        return m_result->all ? items.size() : m_result->rows.size();
+      }
+
+      // Number of matching items, more than size() when only the best fuzzy matches are shown
+      [[nodiscard]] size_t matches(const ItemStore &items) const {
+        return m_result->fuzzy ? m_result->matches : size(items);
+      }
+
+      // The fuzzy pattern of the rows on screen, to highlight the matched characters
+      [[nodiscard]] const match::FuzzyPattern *fuzzy_pattern() const {
+        return m_result->fuzzy ? &m_result->fuzzy_pattern : nullptr;
+      }
+
+      // Item id of a row
+      [[nodiscard]] size_t operator[](size_t row) const {
+        return m_result->all ? row : m_result->rows[row];
+      }
+
+    private:
+      enum Mode {
+        // Filter and sort the whole snapshot
+        FULL,
+        // Filter the rows of the current result with a longer query, then the items appended since
+        REFINE,
+        // Keep the rows of the current result, add the items appended since
+        TAIL
+      };
+
+      // A fuzzy match, better ones have a higher score, then are shorter, then come first
+      struct Ranked {
+        int score;
+        uint32_t length;
+        uint32_t id;
+      };
+
+      struct Result {
+        // Every item in store order, no rows
+        bool all{true};
+        bool filtered{false};
+        bool fuzzy{false};
+        match::Pattern pattern;
+        match::FuzzyPattern fuzzy_pattern;
+        SortOrder order{SortOrder::NONE};
+        size_t column{0};
+        std::vector<uint32_t> rows;
+        // Best fuzzy matches first, the rows before sorting
+        std::vector<Ranked> ranking;
+        size_t matches{0};
+        // Items of the store looked at
+        size_t covered{0};
+      };
+
+      struct Job {
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> done{false};
+        // Written by the job before done is set
+        std::shared_ptr<const Result> result;
+      };
+
+      // Sorted by the item text, or by a table column when there is one
+      struct Sort {
+        SortOrder order{SortOrder::NONE};
+        size_t column{0};
+        std::optional<Table::SortColumn> by_column{};
+      };
+
+      struct Input {
+        Mode mode;
+        ItemStore::Snapshot items;
+        bool filtered;
+        bool fuzzy;
+        match::Pattern pattern;
+        match::FuzzyPattern fuzzy_pattern;
+        Sort sort;
+        std::shared_ptr<const Result> base;
+        // Index to take the candidates of a FULL job from, covering the first candidates_cover items
+        std::optional<TrigramIndex::Reader> index{};
+        size_t candidates_cover{0};
+        bool candidates_exact{false};
+      };
+
+      struct Key {
+        uint64_t prefix;
+        std::string_view text;
+        uint32_t id;
+      };
+
+      // Minimum number of rows per parallel part, below that the overhead isn't worth it
+      static constexpr size_t MIN_PART_ROWS = 16384;
+      static constexpr size_t PARTS_PER_THREAD = 4;
+      // When most items contain the rarest trigram anyway, decoding its posting list costs more
+      // than it saves over scanning
+      static constexpr size_t MIN_INDEX_SELECTIVITY = 4;
+
+      bool m_filtered{false};
+      bool m_fuzzy{false};
+      match::Pattern m_pattern;
+      match::FuzzyPattern m_fuzzy_pattern;
+      SortOrder m_order{SortOrder::NONE};
+      size_t m_column{0};
+      std::shared_ptr<const Result> m_result{std::make_shared<Result>()};
+      std::shared_ptr<Job> m_job;
+
+      [[nodiscard]] bool same_filter(const Result &result) const {
+        if(result.filtered != m_filtered || result.fuzzy != m_fuzzy) {
+          return false;
+        }
+        if(m_fuzzy) {
+          return result.fuzzy_pattern.needle() == m_fuzzy_pattern.needle();
+        }
+        return !m_filtered || (result.pattern.needle() == m_pattern.needle() && result.pattern.prefix() == m_pattern.prefix());
+      }
+
+      [[nodiscard]] bool same_order(const Result &result) const {
+        return result.order == m_order && result.column == m_column;
+      }
+
+      static bool extends(const match::Pattern &pattern, const match::Pattern &base) {
+        if(base.prefix()) {
+          return pattern.prefix() && pattern.needle().starts_with(base.needle());
+        }
+        return pattern.needle().find(base.needle()) != std::string::npos;
+      }
+
+      static bool selective(std::optional<size_t> bound, const TrigramIndex &index) {
+        return bound && *bound <= index.size() / MIN_INDEX_SELECTIVITY;
+      }
+
+      void cancel() {
+        if(m_job) {
+          m_job->cancelled.store(true, std::memory_order_relaxed);
+          m_job.reset();
+        }
+      }
+
+      void start(Mode mode, const Dataset &data, ThreadPool &pool) {
+        cancel();
+        if(!active()) {
+          m_result = std::make_shared<Result>();
+          return;
+        }
+
+        Input input{mode, data.snapshot(), m_filtered, m_fuzzy, m_pattern, m_fuzzy_pattern, {m_order, m_column}, mode == FULL ? nullptr : m_result};
+        if(const auto *table = data.table(); table != nullptr && m_order != SortOrder::NONE && m_column < table->schema().columns.size()) {
+          input.sort.by_column = table->sort_column(m_column);
+        }
+        const auto &index = data.index();
+        if(mode == FULL && m_filtered && !m_fuzzy) {
+          const auto &needle = m_pattern.needle();
+          if(selective(index.candidate_bound(needle), index)) {
+            input.index = index.reader();
+            input.candidates_cover = index.size();
+            input.candidates_exact = needle.size() == TrigramIndex::TRIGRAM_LENGTH && !m_pattern.prefix();
+          }
+        }
+
+        m_job = std::make_shared<Job>();
+        pool.submit([job = m_job, input = std::move(input), &pool]() mutable { run(*job, std::move(input), pool); });
+      }
+
+      static void run(Job &job, Input input, ThreadPool &pool) {
+        MV_PROFILE_SCOPE("ItemView::run");
+        if(input.fuzzy) {
+          run_fuzzy(job, std::move(input), pool);
+          return;
+        }
+        const auto &items = input.items;
+        const auto *pattern = input.filtered ? &input.pattern : nullptr;
+
+        std::vector<uint32_t> rows;
+        size_t from = 0;
+        bool sorted = false;
+        switch(input.mode) {
+        case FULL:
+          if(input.index) {
+            auto candidates = input.index->candidates(input.pattern.needle());
+            // Lets the index catch up again
+            input.index.reset();
+            if(candidates) {
+              rows = input.candidates_exact ? std::move(*candidates) : filter(*candidates, items, *pattern, pool, job);
+              from = input.candidates_cover;
+            }
+          }
+          break;
+        case REFINE:
+          rows = filter(input.base->rows, items, *pattern, pool, job);
+          from = input.base->covered;
+          sorted = is_sorted(*input.base, input.sort);
+          break;
+        case TAIL:
+          rows = input.base->rows;
+          from = input.base->covered;
+          sorted = is_sorted(*input.base, input.sort);
+          break;
+        }
+
+        // Without an order, rows that are in store order stay that way when the scanned items are appended
+        const auto &by = input.sort;
+        auto added = scan(items, from, pattern, pool, job);
+        if(by.order == SortOrder::NONE && (sorted || input.mode == FULL)) {
+          rows.insert(rows.end(), added.begin(), added.end());
+        } else if(sorted) {
+          sort(added, items, by, pool, job);
+          const auto middle = static_cast<std::ptrdiff_t>(rows.size());
+          rows.insert(rows.end(), added.begin(), added.end());
+          std::inplace_merge(rows.begin(), rows.begin() + middle, rows.end(), [&items, &by](uint32_t a, uint32_t b) { return less(make_key(items, a, by), make_key(items, b, by), by.order); });
+        } else {
+          rows.insert(rows.end(), added.begin(), added.end());
+          sort(rows, items, by, pool, job);
+        }
+        if(job.cancelled.load(std::memory_order_relaxed)) {
+          return;
+        }
+
+        auto result = std::make_shared<Result>();
+        result->all = false;
+        result->filtered = input.filtered;
+        result->pattern = std::move(input.pattern);
+        result->order = input.sort.order;
+        result->column = input.sort.column;
+        result->rows = std::move(rows);
+        result->covered = items.size();
+        job.result = std::move(result);
+        job.done.store(true, std::memory_order_release);
+      }
+
+      // Ranks the items from the end of the previous result on and merges them with its ranking
+      static void run_fuzzy(Job &job, Input input, ThreadPool &pool) {
+        const auto &items = input.items;
+        std::vector<Ranked> ranking;
+        size_t matches = 0;
+        size_t from = 0;
+        if(input.mode != FULL) {
+          ranking = input.base->ranking;
+          matches = input.base->matches;
+          from = input.base->covered;
+        }
+
+        matches += rank(items, from, input.fuzzy_pattern, ranking, pool, job);
+        std::vector<uint32_t> rows(ranking.size());
+        std::transform(ranking.begin(), ranking.end(), rows.begin(), [](const Ranked &ranked) { return ranked.id; });
+        if(input.sort.order != SortOrder::NONE) {
+          sort(rows, items, input.sort, pool, job);
+        }
+        if(job.cancelled.load(std::memory_order_relaxed)) {
+          return;
+        }
+
+        auto result = std::make_shared<Result>();
+        result->all = false;
+        result->filtered = true;
+        result->fuzzy = true;
+        result->fuzzy_pattern = std::move(input.fuzzy_pattern);
+        result->order = input.sort.order;
+        result->column = input.sort.column;
+        result->rows = std::move(rows);
+        result->ranking = std::move(ranking);
+        result->matches = matches;
+        result->covered = items.size();
+        job.result = std::move(result);
+        job.done.store(true, std::memory_order_release);
+      }
+
+      static bool is_sorted(const Result &result, const Sort &sort) {
+        return result.order == sort.order && result.column == sort.column;
+      }
+
+      static bool better(const Ranked &a, const Ranked &b) {
+        if(a.score != b.score) {
+          return a.score > b.score;
+        }
+        if(a.length != b.length) {
+          return a.length < b.length;
+        }
+        return a.id < b.id;
+      }
+
+      // A heap ordered by better() has the worst of its items in front
+      static void keep_best(std::vector<Ranked> &heap, const Ranked &ranked) {
+        if(heap.size() < FUZZY_TOP_K) {
+          heap.push_back(ranked);
+          std::push_heap(heap.begin(), heap.end(), better);
+        } else if(better(ranked, heap.front())) {
+          std::pop_heap(heap.begin(), heap.end(), better);
+          heap.back() = ranked;
+          std::push_heap(heap.begin(), heap.end(), better);
+        }
+      }
+
+      // Scores the items from `from` on, one part per chunk, and merges the best of them into
+      // ranking, which ends up sorted best first. Returns the number of matching items.
+      static size_t rank(const ItemStore::Snapshot &items, size_t from, const match::FuzzyPattern &pattern, std::vector<Ranked> &ranking, ThreadPool &pool, const Job &job) {
+        MV_PROFILE_SCOPE("ItemView::rank");
+        struct Part {
+          std::vector<Ranked> heap;
+          size_t matches{0};
+        };
+        const auto first_chunk = from < items.size() ? items.chunk_index_of(from) : items.chunk_count();
+        std::vector<Part> parts(items.chunk_count() - first_chunk);
+        pool.parallel_for(parts.size(), [&](size_t part) {
+          if(job.cancelled.load(std::memory_order_relaxed)) {
+            return;
+          }
+          MV_PROFILE_SCOPE("ItemView::rank chunk");
+          const auto &chunk = items.chunk(first_chunk + part);
+          const auto first = chunk.first_item();
+          const auto end = items.chunk_size(first_chunk + part);
+          auto &[heap, matches] = parts[part];
+          for(auto i = static_cast<uint32_t>(std::max(from, first) - first); i < end; i++) {
+            const auto text = chunk[i];
+            if(const auto score = pattern.score(text)) {
+              keep_best(heap, {*score, static_cast<uint32_t>(text.size()), static_cast<uint32_t>(first + i)});
+              ++matches;
+            }
+          }
+        });
+
+        size_t matches = 0;
+        std::make_heap(ranking.begin(), ranking.end(), better);
+        for(const auto &part : parts) {
+          for(const auto &ranked : part.heap) {
+            keep_best(ranking, ranked);
+          }
+          matches += part.matches;
+        }
+        std::sort_heap(ranking.begin(), ranking.end(), better);
+        return matches;
+      }
+
+      static size_t part_count(size_t rows, const ThreadPool &pool) {
+        return std::clamp<size_t>(rows / MIN_PART_ROWS, 1, pool.thread_count() * PARTS_PER_THREAD);
+      }
+
+      template <typename Part>
+      static std::vector<uint32_t> concat(std::vector<Part> &parts) {
+        size_t size = 0;
+        for(const auto &part : parts) {
+          size += part.size();
+        }
+        std::vector<uint32_t> rows;
+        rows.reserve(size);
+        for(const auto &part : parts) {
+          rows.insert(rows.end(), part.begin(), part.end());
+        }
+        return rows;
+      }
+
+      // The ids of rows that match, in the same order
+      static std::vector<uint32_t> filter(const std::vector<uint32_t> &rows, const ItemStore::Snapshot &items, const match::Pattern &pattern, ThreadPool &pool, const Job &job) {
+        MV_PROFILE_SCOPE("ItemView::filter");
+        const auto count = part_count(rows.size(), pool);
+        std::vector<std::vector<uint32_t>> parts(count);
+        pool.parallel_for(count, [&](size_t part) {
+          MV_PROFILE_SCOPE("ItemView::filter part");
+          const auto begin = rows.size() * part / count;
+          const auto end = rows.size() * (part + 1) / count;
+          for(auto i = begin; i < end && !job.cancelled.load(std::memory_order_relaxed); i++) {
+            if(pattern.matches(items[rows[i]])) {
+              parts[part].push_back(rows[i]);
+            }
+          }
+        });
+        return concat(parts);
+      }
+
+      // The ids of the matching items from `from` on, one part per chunk. Every item without a pattern.
+      static std::vector<uint32_t> scan(const ItemStore::Snapshot &items, size_t from, const match::Pattern *pattern, ThreadPool &pool, const Job &job) {
+        if(from >= items.size()) {
+          return {};
+        }
+        MV_PROFILE_SCOPE("ItemView::scan");
+        const auto first_chunk = items.chunk_index_of(from);
+        std::vector<std::vector<uint32_t>> parts(items.chunk_count() - first_chunk);
+        pool.parallel_for(parts.size(), [&](size_t part) {
+          if(job.cancelled.load(std::memory_order_relaxed)) {
+            return;
+          }
+          MV_PROFILE_SCOPE("ItemView::scan chunk");
+          const auto &chunk = items.chunk(first_chunk + part);
+          const auto first = chunk.first_item();
+          const auto begin = static_cast<uint32_t>(std::max(from, first) - first);
+          const auto end = items.chunk_size(first_chunk + part);
+          auto &found = parts[part];
+          if(pattern == nullptr) {
+            found.resize(end - begin);
+            std::iota(found.begin(), found.end(), static_cast<uint32_t>(first + begin));
+          } else {
+            pattern->for_each_match(chunk, begin, end, [&found, first](uint32_t index) { found.push_back(static_cast<uint32_t>(first + index)); });
+          }
+        });
+        return concat(parts);
+      }
+
+      // Items compare by 8 bytes after the prefix all of them share first, most of the time that's
+      // enough and it doesn't touch the item text. The text is looked up once here, ties compare it
+      // without going through the store. Without an order the key is the id itself.
+      // Table rows compare by the key of the column value (and the text of string fields).
+      static Key make_key(const ItemStore::Snapshot &items, uint32_t id, const Sort &sort, size_t skip = 0) {
+        if(sort.order == SortOrder::NONE) {
+          return {id, {}, id};
+        }
+        if(sort.by_column) {
+          std::string_view field;
+          const auto key = sort.by_column->key(items, id, field);
+          return {key, field, id};
+        }
+        const auto text = items[id];
+        uint64_t prefix = 0;
+        for(auto i = skip; i < skip + sizeof(prefix); i++) {
+          prefix = (prefix << 8U) | (i < text.size() ? static_cast<uint8_t>(text[i]) : 0U);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        }
+        return {prefix, text, id};
+      }
+
+      // Equal items keep their id order in both directions
+      static bool less(const Key &a, const Key &b, SortOrder order) {
+        const bool descending = order == SortOrder::DESCENDING;
+        if(a.prefix != b.prefix) {
+          return (a.prefix < b.prefix) != descending;
+        }
+        if(order != SortOrder::NONE) {
+          const auto cmp = a.text.compare(b.text);
+          if(cmp != 0) {
+            return (cmp < 0) != descending;
+          }
+        }
+        return a.id < b.id;
+      }
+
+      // Sorts runs in parallel, then merges pairs of runs in parallel until one is left
+      static void sort(std::vector<uint32_t> &rows, const ItemStore::Snapshot &items, const Sort &by, ThreadPool &pool, const Job &job) {
+        if(rows.size() < 2) {
+          return;
+        }
+        MV_PROFILE_SCOPE("ItemView::sort");
+        const auto compare = [order = by.order](const Key &a, const Key &b) { return less(a, b, order); };
+
+        const auto count = part_count(rows.size(), pool);
+        std::vector<Key> keys(rows.size());
+        std::vector<size_t> bounds(count + 1);
+        for(size_t i = 0; i <= count; i++) {
+          bounds[i] = rows.size() * i / count;
+        }
+        // Generated and log-like items tend to start the same way
+        std::vector<size_t> shared(count, by.by_column ? 0 : std::string_view::npos);
+        const auto first = items[rows[0]];
+        pool.parallel_for(count, [&](size_t part) {
+          for(auto i = bounds[part]; i < bounds[part + 1] && shared[part] > 0; i++) {
+            const auto text = items[rows[i]];
+            const auto length = std::min({shared[part], first.size(), text.size()});
+            shared[part] = static_cast<size_t>(std::mismatch(first.begin(), first.begin() + static_cast<std::ptrdiff_t>(length), text.begin()).first - first.begin());
+          }
+        });
+        const auto skip = *std::min_element(shared.begin(), shared.end());
+
+        pool.parallel_for(count, [&](size_t part) {
+          MV_PROFILE_SCOPE("ItemView::sort run");
+          for(auto i = bounds[part]; i < bounds[part + 1]; i++) {
+            keys[i] = make_key(items, rows[i], by, skip);
+          }
+          if(!job.cancelled.load(std::memory_order_relaxed)) {
+            std::sort(keys.begin() + static_cast<std::ptrdiff_t>(bounds[part]), keys.begin() + static_cast<std::ptrdiff_t>(bounds[part + 1]), compare);
+          }
+        });
+
+        std::vector<Key> merged(keys.size());
+        for(size_t width = 1; width < count && !job.cancelled.load(std::memory_order_relaxed); width *= 2) {
+          const auto pairs = (count + 2 * width - 1) / (2 * width);
+          pool.parallel_for(pairs, [&](size_t pair) {
+            MV_PROFILE_SCOPE("ItemView::sort merge");
+            const auto begin = bounds[pair * 2 * width];
+            const auto middle = bounds[std::min(count, pair * 2 * width + width)];
+            const auto end = bounds[std::min(count, pair * 2 * width + 2 * width)];
+            const auto at = [](auto &v, size_t i) { return v.begin() + static_cast<std::ptrdiff_t>(i); };
+            std::merge(at(keys, begin), at(keys, middle), at(keys, middle), at(keys, end), at(merged, begin), compare);
+          });
+          keys.swap(merged);
+        }
+
+        for(size_t i = 0; i < rows.size(); i++) {
+          rows[i] = keys[i].id;
+        }
+      }
+  };
+}// namespace mv
@@ -0,0 +1,188 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace mv {
+  /**
+   * HDR style histogram of durations in microseconds.
+   *
+   * Values below 64uS get a bucket each, above that every power of two range is split into 32
+   * linear buckets, i.e. a relative error of at most ~3%. Recording is O(1), values above ~134 s
+   * end up in the last bucket.
+   */
+  class LatencyHistogram {
+    public:
+      static constexpr uint32_t SUB_BUCKET_BITS = 5;
+      static constexpr uint32_t SUB_BUCKETS = 1U << SUB_BUCKET_BITS;
+      static constexpr uint32_t LINEAR_BUCKETS = SUB_BUCKETS * 2;
+      static constexpr uint32_t MAX_EXPONENT = 27;
+      static constexpr uint32_t FIRST_EXPONENT = SUB_BUCKET_BITS + 1;
+      static constexpr size_t BUCKET_COUNT = LINEAR_BUCKETS + (MAX_EXPONENT - FIRST_EXPONENT) * SUB_BUCKETS;
+      static constexpr uint64_t MAX_VALUE = (uint64_t{1} << MAX_EXPONENT) - 1;
+
+      static constexpr size_t bucket_index(uint64_t us) {
+        us = std::min(us, MAX_VALUE);
+        if(us < LINEAR_BUCKETS) {
+          return us;
+        }
+        const auto exponent = static_cast<uint32_t>(std::bit_width(us)) - 1;
+        const auto shift = exponent - SUB_BUCKET_BITS;
+        const auto sub_bucket = static_cast<uint32_t>(us >> shift) - SUB_BUCKETS;
+        return LINEAR_BUCKETS + (exponent - FIRST_EXPONENT) * SUB_BUCKETS + sub_bucket;
+      }
+
+      // Smallest value that ends up in the bucket
+      static constexpr uint64_t bucket_lower_bound(size_t index) {
+        if(index < LINEAR_BUCKETS) {
+          return index;
+        }
+        const auto offset = index - LINEAR_BUCKETS;
+        const auto exponent = FIRST_EXPONENT + static_cast<uint32_t>(offset / SUB_BUCKETS);
+        const auto sub_bucket = SUB_BUCKETS + offset % SUB_BUCKETS;
+        return sub_bucket << (exponent - SUB_BUCKET_BITS);
+      }
+
+      static constexpr uint64_t bucket_upper_bound(size_t index) {
+        return index + 1 < BUCKET_COUNT ? bucket_lower_bound(index + 1) - 1 : MAX_VALUE;
+      }
+
+      void record(uint64_t us) {
+        ++m_counts.at(bucket_index(us));
+        ++m_count;
+        m_sum += us;
+        m_max = std::max(m_max, us);
+      }
+
+      void merge(const LatencyHistogram &other) {
+        for(size_t i = 0; i < BUCKET_COUNT; i++) {
+          m_counts.at(i) += other.m_counts.at(i);
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+      }
+
+      void clear() {
+        m_counts.fill(0);
+        m_count = 0;
+        m_sum = 0;
+        m_max = 0;
+      }
+
+      // Upper bound of the bucket holding the p-th fraction of the samples (0 < p <= 1), never above max()
+      [[nodiscard]] uint64_t percentile(double p) const {
+        if(m_count == 0) {
+          return 0;
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(m_count) + 0.5));// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        uint64_t seen = 0;
+        for(size_t i = 0; i < BUCKET_COUNT; i++) {
+          seen += m_counts.at(i);
+          if(seen >= rank) {
+            return std::min(bucket_upper_bound(i), m_max);
+          }
+        }
+        return m_max;
+      }
+
+      [[nodiscard]] uint64_t count() const {
+        return m_count;
+      }
+
+      [[nodiscard]] uint64_t bucket_count(size_t index) const {
+        return m_counts.at(index);
+      }
+
+      [[nodiscard]] uint64_t max() const {
+        return m_max;
+      }
+
+      [[nodiscard]] double mean() const {
+        return m_count == 0 ? 0.0 : static_cast<double>(m_sum) / static_cast<double>(m_count);
+      }
+
+    private:
+      std::array<uint32_t, BUCKET_COUNT> m_counts{};
+      uint64_t m_count{0};
+      uint64_t m_sum{0};
+      uint64_t m_max{0};
+  };
+
+  /**
+   * Frame time histograms over the last second, the last minute and the whole session.
+   *
+   * Samples go into one histogram per wall clock second (a ring of 60) and the session histogram,
+   * the minute histogram is merged from the ring when asked for.
+   */
+  class FrameTimeStats {
+    public:
+      enum Range {
+        LAST_SECOND,
+        LAST_MINUTE,
+        SESSION,
+        RANGE_COUNT
+      };
+
+      static constexpr std::array<const char *, RANGE_COUNT> RANGE_NAMES = {"Last second", "Last minute", "Session"};
+
+      void record(uint64_t us, int64_t now_ns) {
+        const auto second = now_ns / NS_PER_SECOND;
+        advance_to(second);
+        m_seconds.at(slot(second)).record(us);
+        m_session.record(us);
+      }
+
+      // The last second is the last complete one, the current second is still filling up.
+      [[nodiscard]] LatencyHistogram histogram(Range range, int64_t now_ns) {
+        advance_to(now_ns / NS_PER_SECOND);
+        switch(range) {
+        case LAST_SECOND:
+          return m_seconds.at(slot(m_current_second - 1));
+        case LAST_MINUTE: {
+          LatencyHistogram minute;
+          for(const auto &second : m_seconds) {
+            minute.merge(second);
+          }
+          return minute;
+        }
+        default:
+          return m_session;
+        }
+      }
+
+      void reset_session() {
+        m_session.clear();
+      }
+
+    private:
+      static constexpr int64_t NS_PER_SECOND = 1'000'000'000;
+      static constexpr int64_t SECONDS = 60;
+
+      std::vector<LatencyHistogram> m_seconds = std::vector<LatencyHistogram>(SECONDS);
+      LatencyHistogram m_session{};
+      int64_t m_current_second{0};
+
+      static size_t slot(int64_t second) {
+        return static_cast<size_t>(((second % SECONDS) + SECONDS) % SECONDS);
+      }
+
+      // Clears the slots of the seconds that passed without samples
+      void advance_to(int64_t second) {
+        if(second <= m_current_second) {
+          return;
+        }
+        const auto first = std::max(m_current_second + 1, second - SECONDS + 1);
+        for(auto s = first; s <= second; s++) {
+          m_seconds.at(slot(s)).clear();
+        }
+        m_current_second = second;
+      }
+  };
+}// namespace mv
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Profiler.h"
+
+namespace mv {
+  /**
+   * Tasks posted from any thread that run on the main thread, where ImGui state and the windows
+   * can be touched safely. The application drains the queue once per frame before rendering the
+   * windows; tasks posted while draining run the next frame.
+   *
+   * A task can have an owner, typically the lifetime() of a window: when the owner is gone by the
+   * time the task would run, the task is dropped instead.
+   */
+  class MainThreadQueue {
+    public:
+      using Task = std::function<void()>;
+      using Notify = std::function<void()>;
+
+      // notify is called (on the posting thread) after every post, e.g. to wake up the main loop
+      explicit MainThreadQueue(Notify notify = nullptr) : m_notify(std::move(notify)) {}
+
+      void post(Task task) {
+        push({{}, false, std::move(task)});
+      }
+
+      void post(std::weak_ptr<const void> owner, Task task) {
+        push({std::move(owner), true, std::move(task)});
+      }
+
+      // Main thread only. Returns the number of tasks that ran.
+      size_t drain() {
+        {
+          const std::lock_guard lock(m_mutex);
+          if(m_tasks.empty()) {
+            return 0;
+          }
+          std::swap(m_tasks, m_running);
+        }
+        MV_PROFILE_SCOPE("MainThreadQueue::drain");
+        size_t ran = 0;
+        for(auto &entry : m_running) {
+          if(entry.owned && entry.owner.expired()) {
+            continue;
+          }
+          entry.task();
+          ++ran;
+        }
+        m_running.clear();
+        return ran;
+      }
+
+      [[nodiscard]] size_t size() const {
+        const std::lock_guard lock(m_mutex);
+        return m_tasks.size();
+      }
+
+    private:
+      struct Entry {
+        std::weak_ptr<const void> owner;
+        bool owned;
+        Task task;
+      };
+
+      Notify m_notify;
+      mutable std::mutex m_mutex;
+      std::vector<Entry> m_tasks;
+      // The tasks being run by drain(), kept to reuse the allocation
+      std::vector<Entry> m_running;
+
+      void push(Entry entry) {
+        {
+          const std::lock_guard lock(m_mutex);
+          m_tasks.push_back(std::move(entry));
+        }
+        if(m_notify) {
+          m_notify();
+        }
+      }
+  };
+}// namespace mv
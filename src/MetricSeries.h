@@ -0,0 +1,188 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mv {
+  /**
+   * Fixed capacity ring buffer of metric samples, the oldest sample is overwritten once full.
+   *
+   * Index 0 is the oldest sample. Plot it through an ImPlot getter instead of copying it into
+   * a linear array.
+   */
+  template <typename T>
+  class MetricSeries {
+    public:
+      static constexpr size_t DEFAULT_CAPACITY = 10'000;
+      // Largest history the debug window and --history accept
+      static constexpr size_t MAX_CAPACITY = 10'000'000;
+
+      explicit MetricSeries(size_t capacity = DEFAULT_CAPACITY) : m_samples(std::max<size_t>(capacity, 1)) {}
+
+      void push(T value) {
+        m_samples[m_head] = value;
+        m_head = (m_head + 1) % m_samples.size();
+        m_size = std::min(m_size + 1, m_samples.size());
+        ++m_total;
+      }
+
+      [[nodiscard]] const T &operator[](size_t index) const {
+        return m_samples[(m_head + m_samples.size() - m_size + index) % m_samples.size()];
+      }
+
+      [[nodiscard]] const T &latest() const {
+        return (*this)[m_size - 1];
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_size;
+      }
+
+      [[nodiscard]] bool empty() const {
+        return m_size == 0;
+      }
+
+      [[nodiscard]] size_t capacity() const {
+        return m_samples.size();
+      }
+
+      // Number of samples pushed since creation, including the ones that have been overwritten
+      [[nodiscard]] uint64_t total() const {
+        return m_total;
+      }
+
+      // Keeps the newest samples that fit in the new capacity
+      void set_capacity(size_t capacity) {
+        capacity = std::max<size_t>(capacity, 1);
+        if(capacity == m_samples.size()) {
+          return;
+        }
+
+        const auto keep = std::min(m_size, capacity);
+        std::vector<T> samples(capacity);
+        for(size_t i = 0; i < keep; i++) {
+          samples[i] = (*this)[m_size - keep + i];
+        }
+        m_samples = std::move(samples);
+        m_size = keep;
+        m_head = keep % capacity;
+      }
+
+      void clear() {
+        m_head = 0;
+        m_size = 0;
+      }
+
+    private:
+      std::vector<T> m_samples;
+      size_t m_head{0};
+      size_t m_size{0};
+      uint64_t m_total{0};
+  };
+
+  /**
+   * MetricSeries with a min/max pyramid on top, for plotting long histories.
+   *
+   * Level L (1..) holds the min and max of aligned blocks of 2^L samples, every push updates one
+   * block per level. A plot picks the level where the visible range fits in about one block per
+   * pixel, so the number of plotted points doesn't depend on the history length.
+   */
+  template <typename T>
+  class DecimatedSeries {
+    public:
+      struct Range {
+        T min;
+        T max;
+      };
+
+      explicit DecimatedSeries(size_t capacity = MetricSeries<T>::DEFAULT_CAPACITY) : m_raw(capacity) {
+        rebuild();
+      }
+
+      void push(T value) {
+        const auto sample = m_raw.total();
+        m_raw.push(value);
+        update_levels(sample, value);
+      }
+
+      [[nodiscard]] const MetricSeries<T> &raw() const {
+        return m_raw;
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_raw.size();
+      }
+
+      [[nodiscard]] size_t capacity() const {
+        return m_raw.capacity();
+      }
+
+      void set_capacity(size_t capacity) {
+        m_raw.set_capacity(capacity);
+        rebuild();
+      }
+
+      // Global sample number of raw()[index], block b at level L covers samples [b << L, (b + 1) << L)
+      [[nodiscard]] uint64_t sample_number(size_t index) const {
+        return m_raw.total() - m_raw.size() + index;
+      }
+
+      [[nodiscard]] size_t level_count() const {
+        return m_levels.size() + 1;
+      }
+
+      // Lowest level (0 = raw samples) where [begin, end) is covered by at most max_blocks blocks
+      [[nodiscard]] size_t pick_level(size_t begin, size_t end, size_t max_blocks) const {
+        max_blocks = std::max<size_t>(max_blocks, 1);
+        size_t level = 0;
+        while(level < m_levels.size() && ((end - begin) >> level) > max_blocks) {
+          ++level;
+        }
+        return level;
+      }
+
+      // Level must be 1 or higher
+      [[nodiscard]] const Range &block(size_t level, uint64_t block) const {
+        const auto &blocks = m_levels[level - 1];
+        return blocks[block % blocks.size()];
+      }
+
+    private:
+      MetricSeries<T> m_raw;
+      std::vector<std::vector<Range>> m_levels;
+
+      static constexpr size_t MIN_BLOCKS = 64;
+
+      // first: the oldest sample replayed by rebuild(), which can be partway into its blocks
+      void update_levels(uint64_t sample, T value, bool first = false) {
+        for(size_t i = 0; i < m_levels.size(); i++) {
+          const auto level = i + 1;
+          auto &blocks = m_levels[i];
+          auto &range = blocks[(sample >> level) % blocks.size()];
+          if(first || (sample & ((uint64_t{1} << level) - 1)) == 0) {
+            range = Range{value, value};
+          } else {
+            range.min = std::min(range.min, value);
+            range.max = std::max(range.max, value);
+          }
+        }
+      }
+
+      // The ring of each level is two blocks larger than needed so the partial blocks at both ends
+      // of the retained samples are kept.
+      void rebuild() {
+        m_levels.clear();
+        for(size_t level = 1; (m_raw.capacity() >> level) >= MIN_BLOCKS; level++) {
+          m_levels.emplace_back((m_raw.capacity() >> level) + 2);
+        }
+        for(size_t i = 0; i < m_raw.size(); i++) {
+          update_levels(sample_number(i), m_raw[i], i == 0);
+        }
+      }
+  };
+}// namespace mv
\ No newline at end of file
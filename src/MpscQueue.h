@@ -0,0 +1,90 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mv {
+  /**
+   * Bounded lock-free queue for any number of producer threads and one consumer thread.
+   *
+   * Every slot has a sequence number saying whose turn it is: a producer claims the next slot with
+   * a compare-and-swap on the head, fills it and publishes it by bumping the sequence, the consumer
+   * takes slots in order and hands them back to the producers for the next lap. A producer that
+   * claimed a slot but hasn't published it yet holds back the slots after it.
+   *
+   * The capacity is rounded up to a power of two. try_push() fails when the queue is full, it's up
+   * to the producer to back off.
+   */
+  template <typename T>
+  class MpscQueue {
+    public:
+      explicit MpscQueue(size_t capacity) : m_slots(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask(m_slots.size() - 1) {
+        for(size_t i = 0; i < m_slots.size(); i++) {
+          m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+      }
+
+      // value is only moved from when it was pushed
+      bool try_push(T &&value) {
+        auto head = m_head.load(std::memory_order_relaxed);
+        for(;;) {
+          auto &slot = m_slots[head & m_mask];
+          const auto sequence = slot.sequence.load(std::memory_order_acquire);
+          const auto diff = static_cast<std::intptr_t>(sequence - head);
+          if(diff < 0) {
+            return false;
+          }
+          if(diff > 0) {
+            head = m_head.load(std::memory_order_relaxed);
+          } else if(m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+            slot.value = std::move(value);
+            slot.sequence.store(head + 1, std::memory_order_release);
+            return true;
+          }
+        }
+      }
+
+      // Consumer thread only
+      bool try_pop(T &value) {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        auto &slot = m_slots[tail & m_mask];
+        if(slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+          return false;
+        }
+        value = std::move(slot.value);
+        slot.value = T{};
+        slot.sequence.store(tail + m_slots.size(), std::memory_order_release);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+      }
+
+      // Approximate when called while the other side is active, counts slots still being filled
+      [[nodiscard]] size_t size() const {
+        const auto tail = m_tail.load(std::memory_order_acquire);
+        const auto head = m_head.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+      }
+
+      [[nodiscard]] size_t capacity() const {
+        return m_slots.size();
+      }
+
+    private:
+      struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+      };
+
+      std::vector<Slot> m_slots;
+      size_t m_mask;
+      alignas(64) std::atomic<size_t> m_head{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      alignas(64) std::atomic<size_t> m_tail{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+  };
+}// namespace mv
@@ -0,0 +1,240 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FrameTimeline.h"
+
+/**
+ * Scoped profiler zones.
+ *
+ *   void SomeWindow::render() {
+ *     MV_PROFILE_SCOPE("SomeWindow::render");
+ *     ...
+ *   }
+ *
+ * Zone names must be string literals (or otherwise live for the whole program), only the pointer is
+ * recorded. Without MV_ENABLE_PROFILER (cmake -DENABLE_PROFILER=OFF) the macros expand to nothing.
+ */
+#if defined(MV_ENABLE_PROFILER)
+#define MV_PROFILE_CONCAT_IMPL(a, b) a##b
+#define MV_PROFILE_CONCAT(a, b) MV_PROFILE_CONCAT_IMPL(a, b)
+#define MV_PROFILE_SCOPE(name) const ::mv::profiler::Zone MV_PROFILE_CONCAT(mv_profile_zone_, __COUNTER__)(name)
+#define MV_PROFILE_FUNCTION() MV_PROFILE_SCOPE(static_cast<const char *>(__func__))
+#define MV_PROFILE_THREAD_NAME(name) ::mv::profiler::Profiler::instance().set_thread_name(name)
+#else
+#define MV_PROFILE_SCOPE(name) static_cast<void>(0)
+#define MV_PROFILE_FUNCTION() static_cast<void>(0)
+#define MV_PROFILE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+namespace mv::profiler {
+  static constexpr bool ENABLED =
+#if defined(MV_ENABLE_PROFILER)
+    true;
+#else
+    false;
+#endif
+
+  struct ZoneEvent {
+    const char *name{nullptr};
+    int64_t begin_ns{0};
+    int64_t end_ns{0};
+    uint32_t thread{0};
+    uint32_t depth{0};
+  };
+
+  /**
+   * Single producer (the owning thread) single consumer (the UI thread) ring of finished zones.
+   * Zones are dropped, and counted, when the consumer doesn't keep up. The owning thread retires
+   * the buffer when it exits.
+   */
+  class ThreadBuffer {
+    public:
+      static constexpr size_t CAPACITY = 1U << 14U;
+
+      explicit ThreadBuffer(uint32_t index) : m_index(index) {}
+
+      void push(const ZoneEvent &event) {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if(head - m_tail.load(std::memory_order_acquire) == CAPACITY) {
+          m_dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        m_events[head & MASK] = event;
+        m_head.store(head + 1, std::memory_order_release);
+      }
+
+      template <typename Fn>
+      void drain(Fn &&fn) {
+        const auto head = m_head.load(std::memory_order_acquire);
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        for(; tail != head; ++tail) {
+          fn(m_events[tail & MASK]);
+        }
+        m_tail.store(tail, std::memory_order_release);
+      }
+
+      [[nodiscard]] uint32_t index() const {
+        return m_index;
+      }
+
+      // Called by the owning thread after its last push
+      void retire() {
+        m_retired.store(true, std::memory_order_release);
+      }
+
+      [[nodiscard]] bool retired() const {
+        return m_retired.load(std::memory_order_acquire);
+      }
+
+      [[nodiscard]] uint64_t dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+      }
+
+      uint32_t depth{0};// only touched by the owning thread
+
+    private:
+      static constexpr size_t MASK = CAPACITY - 1;
+
+      uint32_t m_index;
+      std::vector<ZoneEvent> m_events = std::vector<ZoneEvent>(CAPACITY);
+      alignas(64) std::atomic<size_t> m_head{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      alignas(64) std::atomic<size_t> m_tail{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      std::atomic<uint64_t> m_dropped{0};
+      std::atomic<bool> m_retired{false};
+  };
+
+  /**
+   * Owns the per-thread buffers and, on the UI thread, the recent history of all zones.
+   * collect() is called once per frame by the application and frees the buffers of threads that
+   * have exited once they are drained. Their names are kept, the history can still hold their zones.
+   */
+  class Profiler {
+    public:
+      static constexpr size_t HISTORY_CAPACITY = 1U << 16U;
+
+      static Profiler &instance() {
+        static Profiler profiler;
+        return profiler;
+      }
+
+      ThreadBuffer &thread_buffer() {
+        thread_local const ThreadHandle handle{register_thread()};
+        return *handle.buffer;
+      }
+
+      void set_thread_name(std::string name) {
+        const auto index = thread_buffer().index();
+        const std::scoped_lock lock(m_mutex);
+        m_thread_names.at(index) = std::move(name);
+      }
+
+      // UI thread only
+      void collect() {
+        const std::scoped_lock lock(m_mutex);
+        std::erase_if(m_buffers, [this](const std::shared_ptr<ThreadBuffer> &buffer) {
+          // Checked first, everything the thread pushed is drained below
+          const bool retired = buffer->retired();
+          buffer->drain([this](const ZoneEvent &event) {
+            m_history[m_history_head] = event;
+            m_history_head = (m_history_head + 1) % HISTORY_CAPACITY;
+            m_history_size = std::min(m_history_size + 1, HISTORY_CAPACITY);
+          });
+          if(retired) {
+            m_retired_dropped += buffer->dropped();
+          }
+          return retired;
+        });
+      }
+
+      // UI thread only, 0 is the oldest zone. Zones are ordered by the time they ended per thread.
+      [[nodiscard]] size_t history_size() const {
+        return m_history_size;
+      }
+
+      [[nodiscard]] const ZoneEvent &history_at(size_t index) const {
+        return m_history[(m_history_head + HISTORY_CAPACITY - m_history_size + index) % HISTORY_CAPACITY];
+      }
+
+      // Indexed by ZoneEvent::thread, includes threads that have exited
+      [[nodiscard]] std::vector<std::string> thread_names() const {
+        const std::scoped_lock lock(m_mutex);
+        return m_thread_names;
+      }
+
+      [[nodiscard]] uint64_t dropped() const {
+        const std::scoped_lock lock(m_mutex);
+        uint64_t dropped = m_retired_dropped;
+        for(const auto &buffer : m_buffers) {
+          dropped += buffer->dropped();
+        }
+        return dropped;
+      }
+
+    private:
+      // Retires the buffer when the thread exits, the profiler frees it in collect()
+      struct ThreadHandle {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        explicit ThreadHandle(std::shared_ptr<ThreadBuffer> thread_buffer) : buffer(std::move(thread_buffer)) {}
+        ThreadHandle(const ThreadHandle &) = delete;
+        ThreadHandle(ThreadHandle &&) = delete;
+        ThreadHandle &operator=(const ThreadHandle &) = delete;
+        ThreadHandle &operator=(ThreadHandle &&) = delete;
+
+        ~ThreadHandle() {
+          buffer->retire();
+        }
+      };
+
+      mutable std::mutex m_mutex;
+      std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+      std::vector<std::string> m_thread_names;
+      uint64_t m_retired_dropped{0};
+      std::vector<ZoneEvent> m_history = std::vector<ZoneEvent>(HISTORY_CAPACITY);
+      size_t m_history_head{0};
+      size_t m_history_size{0};
+
+      Profiler() = default;
+
+      std::shared_ptr<ThreadBuffer> register_thread() {
+        const std::scoped_lock lock(m_mutex);
+        const auto index = static_cast<uint32_t>(m_thread_names.size());
+        m_thread_names.push_back(index == 0 ? std::string{"main"} : "thread " + std::to_string(index));
+        auto buffer = std::make_shared<ThreadBuffer>(index);
+        m_buffers.push_back(buffer);
+        return buffer;
+      }
+  };
+
+  class Zone {
+    public:
+      explicit Zone(const char *name) : m_buffer(Profiler::instance().thread_buffer()), m_name(name), m_depth(m_buffer.depth++), m_begin_ns(now_ns()) {}
+
+      Zone(const Zone &) = delete;
+      Zone(Zone &&) = delete;
+      Zone &operator=(const Zone &) = delete;
+      Zone &operator=(Zone &&) = delete;
+
+      ~Zone() {
+        --m_buffer.depth;
+        m_buffer.push(ZoneEvent{m_name, m_begin_ns, now_ns(), m_buffer.index(), m_depth});
+      }
+
+    private:
+      ThreadBuffer &m_buffer;
+      const char *m_name;
+      uint32_t m_depth;
+      int64_t m_begin_ns;
+  };
+}// namespace mv::profiler
\ No newline at end of file
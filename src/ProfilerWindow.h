@@ -0,0 +1,289 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <imgui.h>
+#include <imgui_internal.h>
+#include <spdlog/spdlog.h>
+
+#define UUID_SYSTEM_GENERATOR
+#include <uuid.h>
+
+#include "Application.h"
+#include "FrameTimeline.h"
+#include "ImGuiUtil.h"
+#include "Profiler.h"
+#include "Window.h"
+
+namespace mv {
+  /**
+   * Flame graph style timeline of the profiler zones recorded during the last frames, one lane
+   * group per thread and one row per nesting depth.
+   *
+   * Mouse wheel zooms around the cursor, dragging pans, double click resets the view. Zooming or
+   * panning pauses the capture. With auto capture enabled the window pauses on the first frame
+   * slower than the threshold.
+   */
+  class ProfilerWindow : public Window {
+    public:
+      explicit ProfilerWindow(Application &app) : m_app(app) {
+        uuids::uuid id = uuids::uuid_system_generator{}();
+        m_window_title = "Profiler###" + uuids::to_string(id);
+      }
+
+      // A slow frame is caught while the window is hidden too
+      void update() override {
+        if constexpr(profiler::ENABLED) {
+          if(!m_paused) {
+            check_auto_capture();
+          }
+        }
+      }
+
+      void render() override {
+        MV_PROFILE_SCOPE("ProfilerWindow::render");
+        ImGui::SetNextWindowPos(ImVec2(DEFAULT_WINDOW_POS_X, DEFAULT_WINDOW_POS_Y), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT), ImGuiCond_FirstUseEver);
+
+        if(begin_window(ImGuiWindowFlags_NoSavedSettings)) {
+          if constexpr(profiler::ENABLED) {
+            if(!m_paused) {
+              capture(m_frame_count);
+            }
+            render_controls();
+            render_timeline();
+          } else {
+            y44::im_text("Profiler zones are disabled, configure with -DENABLE_PROFILER=ON");
+          }
+        }
+        ImGui::End();
+      }
+
+      [[nodiscard]] bool needs_continuous_redraw() const override {
+        return !m_paused;
+      }
+
+    private:
+      struct Capture {
+        std::vector<profiler::ZoneEvent> zones;
+        std::vector<FrameRecord> frames;
+        std::vector<std::string> thread_names;
+        int64_t begin_ns{0};
+        int64_t end_ns{0};
+      };
+
+      Application &m_app;
+      Capture m_capture;
+      double m_view_begin_ns{0.0};
+      double m_view_end_ns{0.0};
+      int m_frame_count{DEFAULT_FRAME_COUNT};
+      float m_capture_threshold_ms{DEFAULT_CAPTURE_THRESHOLD_MS};
+      bool m_paused{false};
+      bool m_auto_capture{false};
+      uint64_t m_captured_frame{0};
+      uint64_t m_last_checked_frame{0};
+
+      static constexpr int DEFAULT_FRAME_COUNT = 3;
+      static constexpr int MAX_FRAME_COUNT = 120;
+      static constexpr float DEFAULT_CAPTURE_THRESHOLD_MS = 33.0F;
+      static constexpr float DEFAULT_WINDOW_POS_X = 100.0F;
+      static constexpr float DEFAULT_WINDOW_POS_Y = 600.0F;
+      static constexpr float DEFAULT_WINDOW_WIDTH = 1200.0F;
+      static constexpr float DEFAULT_WINDOW_HEIGHT = 400.0F;
+      static constexpr float ZOOM_STEP = 1.2F;
+      static constexpr float MIN_VIEW_NS = 1000.0F;
+      static constexpr float TEXT_PADDING = 4.0F;
+
+      void check_auto_capture() {
+        const auto &timeline = m_app.frame_timeline();
+        if(!m_auto_capture || timeline.size() == 0) {
+          return;
+        }
+
+        const auto &frame = timeline.latest();
+        if(frame.frame == m_last_checked_frame) {
+          return;
+        }
+        m_last_checked_frame = frame.frame;
+
+        // Time spent waiting for the next frame is not interesting
+        if(frame.total_ms() - frame.phase_ms(PHASE_PACING) > m_capture_threshold_ms) {
+          capture(1);
+          m_captured_frame = frame.frame;
+          m_paused = true;
+        }
+      }
+
+      // Copies the zones of the last frame_count frames out of the profiler history.
+      void capture(int frame_count) {
+        const auto &timeline = m_app.frame_timeline();
+        const auto &profiler = profiler::Profiler::instance();
+
+        m_capture.zones.clear();
+        m_capture.frames.clear();
+        m_capture.thread_names = profiler.thread_names();
+        if(timeline.size() == 0) {
+          return;
+        }
+
+        const auto frames = std::min(timeline.size(), static_cast<size_t>(frame_count));
+        for(size_t i = timeline.size() - frames; i < timeline.size(); i++) {
+          m_capture.frames.push_back(timeline.at(i));
+        }
+        m_capture.begin_ns = m_capture.frames.front().begin_ns;
+        m_capture.end_ns = m_capture.frames.back().end_ns;
+
+        for(size_t i = 0; i < profiler.history_size(); i++) {
+          const auto &zone = profiler.history_at(i);
+          if(zone.end_ns >= m_capture.begin_ns && zone.begin_ns <= m_capture.end_ns) {
+            m_capture.zones.push_back(zone);
+          }
+        }
+        reset_view();
+      }
+
+      void reset_view() {
+        m_view_begin_ns = static_cast<double>(m_capture.begin_ns);
+        m_view_end_ns = static_cast<double>(m_capture.end_ns);
+      }
+
+      void render_controls() {
+        if(ImGui::Checkbox("Pause", &m_paused) && !m_paused) {
+          m_captured_frame = 0;
+        }
+        ImGui::SameLine();
+        ImGui::Checkbox("Auto capture frames slower than", &m_auto_capture);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        ImGui::DragFloat("mS##threshold", &m_capture_threshold_ms, 0.1F, 1.0F, 1000.0F, "%.1f");// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        ImGui::SliderInt("frames", &m_frame_count, 1, MAX_FRAME_COUNT);
+
+        if(m_captured_frame != 0) {
+          y44::im_text("Captured frame #{}", m_captured_frame);
+        } else {
+          y44::im_text("{} zones, {} dropped", m_capture.zones.size(), profiler::Profiler::instance().dropped());
+        }
+      }
+
+      [[nodiscard]] static ImU32 zone_color(const char *name) {
+        const auto hash = std::hash<const void *>{}(name);
+        const auto hue = static_cast<float>(hash % 360U) / 360.0F;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+        return ImColor::HSV(hue, 0.5F, 0.7F);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      }
+
+      void handle_zoom_and_pan(const ImVec2 &canvas_min, float canvas_width) {
+        const auto &io = ImGui::GetIO();
+        const auto view_ns = m_view_end_ns - m_view_begin_ns;
+        const auto ns_per_px = view_ns / static_cast<double>(canvas_width);
+
+        if(ImGui::IsItemHovered() && io.MouseWheel != 0.0F) {
+          const auto cursor_ns = m_view_begin_ns + static_cast<double>(io.MousePos.x - canvas_min.x) * ns_per_px;
+          const auto factor = std::pow(static_cast<double>(ZOOM_STEP), static_cast<double>(-io.MouseWheel));
+          const auto new_view_ns = std::max(static_cast<double>(MIN_VIEW_NS), view_ns * factor);
+          const auto ratio = new_view_ns / view_ns;
+          m_view_begin_ns = cursor_ns - (cursor_ns - m_view_begin_ns) * ratio;
+          m_view_end_ns = m_view_begin_ns + new_view_ns;
+          m_paused = true;
+        }
+
+        if(ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+          const auto delta_ns = static_cast<double>(io.MouseDelta.x) * ns_per_px;
+          m_view_begin_ns -= delta_ns;
+          m_view_end_ns -= delta_ns;
+          m_paused = true;
+        }
+
+        if(ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+          reset_view();
+        }
+      }
+
+      void render_timeline() {
+        MV_PROFILE_SCOPE("ProfilerWindow::render_timeline");
+        const auto canvas_min = ImGui::GetCursorScreenPos();
+        const auto canvas_size = ImGui::GetContentRegionAvail();
+        if(canvas_size.x < 1.0F || canvas_size.y < 1.0F || m_view_end_ns <= m_view_begin_ns) {
+          return;
+        }
+        const auto canvas_max = canvas_min + canvas_size;
+
+        ImGui::InvisibleButton("##timeline", canvas_size);
+        handle_zoom_and_pan(canvas_min, canvas_size.x);
+
+        const auto row_height = ImGui::GetTextLineHeightWithSpacing();
+        const auto scale = static_cast<double>(canvas_size.x) / (m_view_end_ns - m_view_begin_ns);
+        const auto to_x = [&](int64_t ns) {
+          return canvas_min.x + static_cast<float>((static_cast<double>(ns) - m_view_begin_ns) * scale);
+        };
+
+        // Lane layout, a header row with the thread name followed by one row per depth
+        std::vector<uint32_t> max_depth(m_capture.thread_names.size(), 0);
+        for(const auto &zone : m_capture.zones) {
+          if(zone.thread < max_depth.size()) {
+            max_depth[zone.thread] = std::max(max_depth[zone.thread], zone.depth + 1);
+          }
+        }
+        std::vector<float> lane_y(max_depth.size(), 0.0F);
+        float y = canvas_min.y;
+        for(size_t t = 0; t < max_depth.size(); t++) {
+          lane_y[t] = y + row_height;
+          y += row_height * static_cast<float>(max_depth[t] + 1);
+        }
+
+        auto *draw_list = ImGui::GetWindowDrawList();
+        draw_list->PushClipRect(canvas_min, canvas_max, true);
+        draw_list->AddRectFilled(canvas_min, canvas_max, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+        for(const auto &frame : m_capture.frames) {
+          const auto x = to_x(frame.begin_ns);
+          draw_list->AddLine(ImVec2(x, canvas_min.y), ImVec2(x, canvas_max.y), ImGui::GetColorU32(ImGuiCol_Separator));
+          draw_list->AddText(ImVec2(x + TEXT_PADDING, canvas_max.y - row_height), ImGui::GetColorU32(ImGuiCol_TextDisabled), fmt::format("#{} {:.2f} mS", frame.frame, frame.total_ms()).c_str());
+        }
+
+        for(size_t t = 0; t < max_depth.size(); t++) {
+          if(max_depth[t] > 0) {
+            draw_list->AddText(ImVec2(canvas_min.x + TEXT_PADDING, lane_y[t] - row_height), ImGui::GetColorU32(ImGuiCol_TextDisabled), m_capture.thread_names[t].c_str());
+          }
+        }
+
+        const auto mouse = ImGui::GetIO().MousePos;
+        const profiler::ZoneEvent *hovered = nullptr;
+        for(const auto &zone : m_capture.zones) {
+          if(zone.thread >= lane_y.size()) {
+            continue;
+          }
+          const auto x0 = std::max(to_x(zone.begin_ns), canvas_min.x);
+          const auto x1 = std::min(std::max(to_x(zone.end_ns), x0 + 1.0F), canvas_max.x);
+          if(x1 < canvas_min.x || x0 > canvas_max.x) {
+            continue;
+          }
+          const auto y0 = lane_y[zone.thread] + row_height * static_cast<float>(zone.depth);
+          const auto min = ImVec2(x0, y0);
+          const auto max = ImVec2(x1, y0 + row_height - 1.0F);
+          draw_list->AddRectFilled(min, max, zone_color(zone.name));
+
+          if(x1 - x0 > ImGui::CalcTextSize(zone.name).x + TEXT_PADDING * 2) {
+            draw_list->AddText(ImVec2(x0 + TEXT_PADDING, y0), ImGui::GetColorU32(ImGuiCol_Text), zone.name);
+          }
+          if(ImGui::IsItemHovered() && ImRect(min, max).Contains(mouse)) {
+            hovered = &zone;
+          }
+        }
+        draw_list->PopClipRect();
+
+        if(hovered != nullptr) {
+          ImGui::SetTooltip("%s\n%.3f mS", hovered->name, static_cast<double>(hovered->end_ns - hovered->begin_ns) / static_cast<double>(FrameRecord::NS_PER_MS));
+        }
+      }
+  };
+}// namespace mv
\ No newline at end of file
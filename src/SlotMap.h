@@ -0,0 +1,137 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mv {
+  // Refers to a value in a SlotMap. A default constructed key refers to nothing.
+  struct SlotKey {
+    uint32_t index{std::numeric_limits<uint32_t>::max()};
+    uint32_t generation{0};
+
+    friend bool operator==(const SlotKey &, const SlotKey &) = default;
+  };
+
+  /**
+   * Values stored contiguously (iteration is a walk over a vector) that are referred to by keys
+   * which stay valid while values come and go.
+   *
+   * A key is the index of a slot plus the generation the slot had when the value was inserted. The
+   * slot points at the value; erasing moves the last value into the hole (so the order of the
+   * values changes), points its slot there and bumps the generation of the erased value's slot,
+   * which makes every key to it stale. Insert, erase and lookup are O(1) and a stale key is never
+   * mistaken for the value that reuses its slot later.
+   */
+  template <typename T>
+  class SlotMap {
+    public:
+      SlotKey insert(T value) {
+        uint32_t index = 0;
+        if(m_free != NONE) {
+          index = m_free;
+          m_free = m_slots[index].target;
+        } else {
+          index = static_cast<uint32_t>(m_slots.size());
+          m_slots.push_back({});
+        }
+        auto &slot = m_slots[index];
+        slot.target = static_cast<uint32_t>(m_values.size());
+        m_values.push_back(std::move(value));
+        m_value_slots.push_back(index);
+        return {index, slot.generation};
+      }
+
+      // False if key is stale
+      bool erase(SlotKey key) {
+        if(!contains(key)) {
+          return false;
+        }
+        auto &slot = m_slots[key.index];
+        const auto position = slot.target;
+        if(position + 1 != m_values.size()) {
+          m_values[position] = std::move(m_values.back());
+          m_value_slots[position] = m_value_slots.back();
+          m_slots[m_value_slots[position]].target = position;
+        }
+        m_values.pop_back();
+        m_value_slots.pop_back();
+        ++slot.generation;
+        slot.target = m_free;
+        m_free = key.index;
+        return true;
+      }
+
+      [[nodiscard]] bool contains(SlotKey key) const {
+        return key.index < m_slots.size() && m_slots[key.index].generation == key.generation;
+      }
+
+      // Null if key is stale. Valid until the map is changed.
+      [[nodiscard]] T *find(SlotKey key) {
+        return contains(key) ? &m_values[m_slots[key.index].target] : nullptr;
+      }
+
+      [[nodiscard]] const T *find(SlotKey key) const {
+        return contains(key) ? &m_values[m_slots[key.index].target] : nullptr;
+      }
+
+      // Values by position, 0 to size() - 1
+      [[nodiscard]] T &operator[](size_t position) {
+        return m_values[position];
+      }
+
+      [[nodiscard]] const T &operator[](size_t position) const {
+        return m_values[position];
+      }
+
+      // Key of the value at position
+      [[nodiscard]] SlotKey key(size_t position) const {
+        const auto index = m_value_slots[position];
+        return {index, m_slots[index].generation};
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_values.size();
+      }
+
+      [[nodiscard]] bool empty() const {
+        return m_values.empty();
+      }
+
+      [[nodiscard]] auto begin() {
+        return m_values.begin();
+      }
+
+      [[nodiscard]] auto end() {
+        return m_values.end();
+      }
+
+      [[nodiscard]] auto begin() const {
+        return m_values.begin();
+      }
+
+      [[nodiscard]] auto end() const {
+        return m_values.end();
+      }
+
+    private:
+      static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+      struct Slot {
+        // Position of the value, or the next free slot
+        uint32_t target{NONE};
+        uint32_t generation{0};
+      };
+
+      std::vector<T> m_values;
+      // Slot of each value, to fix it up when the value moves
+      std::vector<uint32_t> m_value_slots;
+      std::vector<Slot> m_slots;
+      uint32_t m_free{NONE};
+  };
+}// namespace mv
@@ -3,7 +3,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include <fmt/format.h>
 #include <imgui.h>
@@ -17,12 +24,22 @@
 
 #include "Application.h"
 #include "ImGuiUtil.h"
+#include "Dataset.h"
+#include "ItemLoader.h"
+#include "ItemStoreFile.h"
+#include "ItemView.h"
+#include "Profiler.h"
+#include "Table.h"
+#include "Task.h"
 #include "Window.h"
 
 namespace mv {
   class SplitViewWindow : public Window {
     public:
-      SplitViewWindow() {
+      // Shows data (a new, empty dataset if null) together with the other windows showing it
+      explicit SplitViewWindow(Application &app, std::shared_ptr<Dataset> data = nullptr)
+        : m_app(app),
+          m_data(data ? std::move(data) : std::make_shared<Dataset>()) {
         uuids::uuid id = uuids::uuid_system_generator{}();
         m_window_id = uuids::to_string(id);
         m_window_title = fmt::format("MV-1337 ###{}", m_window_id);
@@ -43,16 +60,25 @@ namespace mv {
         | +--------+ |                  |
         +------------+------------------+
         **/
+      // Loading, indexing and filtering go on while the window is hidden
+      void update() override {
+        MV_PROFILE_SCOPE("SplitViewWindow::update");
+        m_data->update(ImGui::GetFrameCount());
+        update_view();
+      }
+
       void render() override {
+        MV_PROFILE_SCOPE("SplitViewWindow::render");
         ImGui::SetNextWindowSizeConstraints(ImVec2(MINIMUM_WINDOW_WIDTH, MINIMUM_WINDOW_HEIGHT), ImVec2(FLT_MAX, FLT_MAX));
         ImGui::SetNextWindowPos(ImVec2(DEFAULT_WINDOW_POS_X, DEFAULT_WINDOW_POS_Y), ImGuiCond_FirstUseEver);
         ImGui::SetNextWindowSize(ImVec2(DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT), ImGuiCond_FirstUseEver);
 
-        is_disabled = m_items.size() > 10;
-
-        if(ImGui::Begin(m_window_title.c_str(), &m_is_open, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_MenuBar)) {
+        if(begin_window(ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_MenuBar)) {
+          if(ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows)) {
+            m_app.set_current_dataset(m_data);
+          }
           ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
-          ImGui::BeginDisabled(is_disabled);
+          ImGui::BeginDisabled(is_loading());
 
           if(!m_hide_search) {
             render_left_child();
@@ -69,26 +95,43 @@ namespace mv {
           render_right_child();
 
           ImGui::EndDisabled();
-          if(is_disabled) {
-            y44::im_popup_modal("Please wait!", m_window_id);
+          if(is_loading()) {
+            render_progress();
           }
           ImGui::PopStyleVar();
 
           render_menu();
+          render_load_file_popup();
+          render_store_file_popup();
           process_shortcuts();
         }
         ImGui::End();
       }
 
+      [[nodiscard]] bool needs_continuous_redraw() const override {
+        return m_data->is_loading() || m_data->is_parsing() || m_data->is_indexing() || m_view.busy();
+      }
+
     private:
-      std::string m_window_title{};
+      Application &m_app;
       std::string m_window_id{};
       std::string m_some_input{};
-      std::vector<std::string> m_items{};
+      std::string m_load_path{};
+      std::string m_store_path{};
+      std::string m_search{};
+      bool m_fuzzy{false};
+      std::shared_ptr<Dataset> m_data;
+      ItemView m_view{};
+      // Reused for every highlighted row
+      std::vector<uint32_t> m_match_positions{};
+      std::vector<y44::TextSpan> m_match_spans{};
+      // Numbers and timestamps of the visible cells are formatted into this one at a time
+      fmt::memory_buffer m_cell_buffer{};
+      bool m_open_load_file{false};
+      bool m_open_store_file{false};
       float m_horizontal_split{DEFAULT_HORIZONTAL_SPLIT};
       float m_vertical_split{DEFAULT_VERTICAL_SPLIT};
       bool m_hide_search{false};
-      bool is_disabled{false};
 
       static constexpr float DEFAULT_HORIZONTAL_SPLIT = 150.0F;
       static constexpr float DEFAULT_VERTICAL_SPLIT = 250.0F;
@@ -100,6 +143,193 @@ namespace mv {
       static constexpr float MINIMUM_WINDOW_WIDTH = 300.0F;
       static constexpr float MINIMUM_SPLIT_SIZE = 50.0F;
       static constexpr float SPLIT_GAP = 8.0F;
+      static constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+      static constexpr uint64_t GENERATE_SMALL = 100'000;
+      static constexpr uint64_t GENERATE_MEDIUM = 1'000'000;
+      static constexpr uint64_t GENERATE_LARGE = 10'000'000;
+      static constexpr float ITEM_COLUMN_WIDTH = 100.0F;
+      static inline const ImU32 MATCH_COLOR = ImColor(0xff, 0x79, 0xc6);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+
+      [[nodiscard]] const ItemStore &items() const {
+        return m_data->items();
+      }
+
+      [[nodiscard]] bool is_loading() const {
+        return m_data->is_loading();
+      }
+
+      template <typename Factory>
+      void start_loading(Factory &&factory) {
+        try {
+          m_data->start_loading(factory(&Application::request_redraw));
+        } catch(const std::exception &e) {
+          spdlog::error("{}", e.what());
+        }
+      }
+
+      // Runs even when the window is collapsed so the dataset keeps loading and the rows keep up
+      void update_view() {
+        m_view.update(*m_data, m_app.thread_pool());
+      }
+
+      // Other windows showing the current dataset keep it
+      void use_dataset(std::shared_ptr<Dataset> data) {
+        m_data = std::move(data);
+        m_view.reset(*m_data, m_app.thread_pool());
+      }
+
+      // Switches to a new, empty dataset
+      void clear_items() {
+        use_dataset(std::make_shared<Dataset>());
+      }
+
+      // A table or a store file gets a dataset of its own, lines are added to a plain list of items
+      void load_file(const std::string &path) {
+        if(std::filesystem::path(path).extension() == ItemStoreFile::EXTENSION) {
+          try {
+            use_dataset(Dataset::open(path));
+          } catch(const std::exception &e) {
+            spdlog::error("{}", e.what());
+          }
+          return;
+        }
+        m_app.tasks().spawn(*this, open_file(path));
+      }
+
+      // Reading the lines the schema is guessed from can take a while (network drives)
+      Task<> open_file(std::string path) {
+        co_await resume_on_pool();
+        auto schema = Schema::of_file(path);
+        co_await resume_on_ui();
+        start_file(path, std::move(schema));
+      }
+
+      void start_file(const std::string &path, std::optional<Schema> schema) {
+        if(is_loading()) {
+          spdlog::warn("Not loading {}, already loading {}", path, m_data->loader()->name());
+          return;
+        }
+        const bool header = schema.has_value();
+        if(schema) {
+          use_dataset(std::make_shared<Dataset>(std::move(*schema)));
+        } else if(m_data->table() != nullptr) {
+          clear_items();
+        }
+        start_loading([&path, header](auto notify) { return ItemLoader::from_file(path, std::move(notify), header); });
+      }
+
+      [[nodiscard]] size_t column_count() const {
+        return m_data->table() != nullptr ? m_data->table()->schema().columns.size() : 1;
+      }
+
+      // Number of rows in the table, all items or the matches of the search. Only the rows parsed
+      // so far of a dataset with a table.
+      [[nodiscard]] size_t row_count() const {
+        return std::min(m_view.size(items()), m_data->rows());
+      }
+
+      [[nodiscard]] std::string_view row_text(size_t row) const {
+        return items()[m_view[row]];
+      }
+
+      void render_row(size_t row) {
+        const auto text = row_text(row);
+        const auto *pattern = m_view.fuzzy_pattern();
+        if(pattern == nullptr) {
+          y44::im_text_unformatted(text);
+          return;
+        }
+        // Only the visible rows are scored again for the positions, the ranking doesn't keep them
+        m_match_positions.clear();
+        m_match_spans.clear();
+        static_cast<void>(pattern->score(text, &m_match_positions));
+        for(const auto pos : m_match_positions) {
+          if(!m_match_spans.empty() && m_match_spans.back().end == pos) {
+            ++m_match_spans.back().end;
+          } else {
+            m_match_spans.push_back({pos, pos + 1, MATCH_COLOR});
+          }
+        }
+        y44::im_text_spans(text, m_match_spans);
+      }
+
+      // Only the cells on screen are formatted
+      void render_cells(size_t row) {
+        const auto &table = *m_data->table();
+        for(size_t column = 0; column < table.schema().columns.size(); column++) {
+          ImGui::TableSetColumnIndex(static_cast<int>(column));
+          y44::im_text_unformatted(table.cell(items(), m_view[row], column, m_cell_buffer));
+        }
+      }
+
+      void set_query() {
+        m_view.set_query(m_search, m_fuzzy, *m_data, m_app.thread_pool());
+      }
+
+      void update_sort_order() {
+        auto *specs = ImGui::TableGetSortSpecs();
+        if(specs == nullptr || !specs->SpecsDirty) {
+          return;
+        }
+        auto order = SortOrder::NONE;
+        size_t column = 0;
+        if(specs->SpecsCount > 0) {
+          order = specs->Specs[0].SortDirection == ImGuiSortDirection_Descending ? SortOrder::DESCENDING : SortOrder::ASCENDING;
+          column = static_cast<size_t>(specs->Specs[0].ColumnIndex);
+        }
+        m_view.set_order(order, column, *m_data, m_app.thread_pool());
+        specs->SpecsDirty = false;
+      }
+
+      void render_progress() {
+        if(m_data->loader()->cancelled()) {
+          y44::im_popup_modal("Cancelling...", m_window_id);
+          return;
+        }
+        const auto status = fmt::format("{} items, {:.0f} rows/s", m_data->loader()->rows(), m_data->loader()->rows_per_second());
+        if(y44::im_progress_modal(fmt::format("Loading {}", m_data->loader()->name()), m_data->loader()->progress(), status, m_window_id)) {
+          m_data->loader()->cancel();
+        }
+      }
+
+      // Asks for a path, returns true when the button was clicked (or Enter pressed)
+      static bool render_path_popup(const char *name, std::string_view help, const char *button, bool &open, std::string &path) {
+        if(open) {
+          ImGui::OpenPopup(name);
+          open = false;
+        }
+        bool confirmed = false;
+        if(ImGui::BeginPopupModal(name, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+          y44::im_text("{}", help);
+          const bool entered = ImGui::InputText("###path", &path, ImGuiInputTextFlags_EnterReturnsTrue);
+          if(ImGui::Button(button) || entered) {
+            confirmed = true;
+            ImGui::CloseCurrentPopup();
+          }
+          ImGui::SameLine();
+          if(ImGui::Button("Cancel") || ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape))) {
+            ImGui::CloseCurrentPopup();
+          }
+          ImGui::EndPopup();
+        }
+        return confirmed;
+      }
+
+      void render_load_file_popup() {
+        if(render_path_popup("Load file", "One item per line, .csv and .tsv files with a header line are loaded as a table, .mvstore files are opened", "Load", m_open_load_file, m_load_path)) {
+          load_file(m_load_path);
+        }
+      }
+
+      void render_store_file_popup() {
+        if(render_path_popup("Keep in store file", "The items are written to the file, and so are items added later. Load it to get them back right away.", "Store", m_open_store_file, m_store_path)) {
+          try {
+            m_data->store_in(m_store_path);
+          } catch(const std::exception &e) {
+            spdlog::error("{}", e.what());
+          }
+        }
+      }
 
       void render_menu() {
         if(ImGui::BeginMenuBar()) {
@@ -110,16 +340,55 @@ namespace mv {
 
             ImGui::MenuItem("Hide search", "⌘+B", &m_hide_search);
 
-            if(is_disabled) {
+            ImGui::Separator();
+            if(ImGui::MenuItem("New view", "⌘+N")) {
+              m_app.open_window(std::make_unique<SplitViewWindow>(m_app, m_data));
+            }
+            if(ImGui::MenuItem("Clear list", nullptr, false, !is_loading())) {
+              clear_items();
+            }
+            ImGui::EndMenu();
+          }
+          if(ImGui::BeginMenu("Items")) {
+            if(ImGui::MenuItem("Load file...", nullptr, false, !is_loading())) {
+              m_open_load_file = true;
+            }
+            if(ImGui::MenuItem("Keep in store file...", nullptr, false, m_data->file() == nullptr && m_data->table() == nullptr)) {
+              m_open_store_file = true;
+            }
+            if(ImGui::BeginMenu("Generate", !is_loading())) {
+              for(const auto count : {GENERATE_SMALL, GENERATE_MEDIUM, GENERATE_LARGE}) {
+                if(ImGui::MenuItem(fmt::format("{} items", count).c_str())) {
+                  if(m_data->table() != nullptr) {
+                    clear_items();
+                  }
+                  start_loading([count](auto notify) { return ItemLoader::from_generator(count, std::move(notify)); });
+                }
+              }
               ImGui::Separator();
-              if(ImGui::MenuItem("Clear list")) {
-                m_items.clear();
+              for(const auto count : {GENERATE_SMALL, GENERATE_MEDIUM, GENERATE_LARGE}) {
+                if(ImGui::MenuItem(fmt::format("{} table rows", count).c_str())) {
+                  use_dataset(std::make_shared<Dataset>(ItemLoader::generated_table_schema()));
+                  start_loading([count](auto notify) { return ItemLoader::from_table_generator(count, std::move(notify)); });
+                }
               }
+              ImGui::EndMenu();
+            }
+            if(ImGui::MenuItem("Copy to new window", nullptr, false, !is_loading())) {
+              m_app.open_window(std::make_unique<SplitViewWindow>(m_app, m_data->fork()));
+            }
+            ImGui::Separator();
+            if(ImGui::MenuItem("Cancel loading", "Esc", false, is_loading() && !m_data->loader()->cancelled())) {
+              m_data->loader()->cancel();
             }
             ImGui::EndMenu();
           }
           ImGui::SameLine(0, 100);
-          ImGui::MenuItem(fmt::format("{}", m_items.size()).c_str(), nullptr, false, false);
+          if(m_view.active()) {
+            ImGui::MenuItem(fmt::format("{} of {}", m_view.matches(items()), items().size()).c_str(), nullptr, false, false);
+          } else {
+            ImGui::MenuItem(fmt::format("{}", items().size()).c_str(), nullptr, false, false);
+          }
 
           ImGui::EndMenuBar();
         }
@@ -133,11 +402,20 @@ namespace mv {
         if(y44::im_shortcut(ImGuiModFlags_Super, ImGuiKey_B, false)) {
           m_hide_search = !m_hide_search;
         }
+        if(is_loading() && ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape), false)) {
+          m_data->loader()->cancel();
+        }
       }
 
       void render_top_left_child() {
         ImGui::BeginChild("child2", ImVec2(0, m_horizontal_split), true);
-        y44::im_text("left upper");
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if(ImGui::InputTextWithHint("###search", "Filter", &m_search)) {
+          set_query();
+        }
+        if(ImGui::Checkbox("Fuzzy", &m_fuzzy)) {
+          set_query();
+        }
         y44::im_text("m_vertical_split = {}", m_horizontal_split);
 
         ImGui::NewLine();
@@ -146,11 +424,12 @@ namespace mv {
         ImGui::InputText("###some_input", &m_some_input);
         ImGui::SameLine();
         if(ImGui::Button("Add")) {
-          m_items.push_back(m_some_input);
+          m_data->append(m_some_input);
           m_some_input.clear();
         }
         ImGui::EndChild();
       }
+
       void render_bottom_left_child() const {
         ImGui::BeginChild("child3", ImVec2(0, 0), true);
         y44::im_text("left lower");
@@ -160,9 +439,43 @@ namespace mv {
         ImGui::Separator();
         ImGui::NewLine();
 
+        y44::im_text("Indexed {} of {} items", m_data->index().size(), items().size());
+        y44::im_text("Index size {:.1f} MB", static_cast<double>(m_data->index().memory_usage()) / BYTES_PER_MB);
+        if(const auto *file = m_data->file()) {
+          y44::im_text("Stored in {}, {} items", file->path().filename().string(), file->size());
+        }
+        if(m_data.use_count() > 1) {
+          y44::im_text("Shown in {} windows", m_data.use_count());
+        }
+        if(const auto *table = m_data->table()) {
+          render_table_stats(*table);
+        }
+        if(m_view.fuzzy_pattern() != nullptr && m_view.matches(items()) > m_view.size(items())) {
+          y44::im_text("Best {} of {} matches", m_view.size(items()), m_view.matches(items()));
+        }
+        if(m_view.busy()) {
+          y44::im_text(m_view.order() == SortOrder::NONE ? "Searching..." : "Sorting...");
+        }
+
         ImGui::EndChild();
       }
+      // Aggregates of the numeric columns of all rows, not only the matches
+      static void render_table_stats(const Table &table) {
+        ImGui::NewLine();
+        y44::im_text("{} rows, {:.1f} MB of columns", table.size(), static_cast<double>(table.memory_usage()) / BYTES_PER_MB);
+        const auto &columns = table.schema().columns;
+        for(size_t column = 0; column < columns.size(); column++) {
+          if(Table::is_numeric(columns[column].type)) {
+            const auto &stats = table.stats(column);
+            if(stats.count > 0) {
+              y44::im_text("{}: min {:.6g}, mean {:.6g}, max {:.6g}", columns[column].name, stats.min, stats.mean(), stats.max);
+            }
+          }
+        }
+      }
+
       void render_left_child() {
+        MV_PROFILE_SCOPE("SplitViewWindow::render_left_child");
         ImGui::BeginChild("Left", ImVec2(m_vertical_split, 0));
         render_top_left_child();
 
@@ -176,7 +489,9 @@ namespace mv {
 
         ImGui::EndChild();
       }
+
       void render_right_child() {
+        MV_PROFILE_SCOPE("SplitViewWindow::render_right_child");
         ImGui::BeginChild("right", ImVec2(0, 0), true);
         y44::im_text("Right pane");
 
@@ -184,11 +499,37 @@ namespace mv {
         ImGui::Separator();
         ImGui::NewLine();
 
-        if(ImGui::BeginTable(fmt::format("#itemslist{}", m_window_id).c_str(), 1)) {
-          for(auto const &i : m_items) {
-            ImGui::TableNextRow();
-            ImGui::TableSetColumnIndex(0);
-            y44::im_text("{}", i);
+        // Only the visible rows are submitted, the table scrolls by itself so the clipper knows
+        // which rows are visible without the child window having to lay out all of them.
+        // Sorting runs on the thread pool, the rows stay as they are until it's done.
+        // A table has one column per schema column, the ID changes with the number of columns so
+        // ImGui doesn't apply the widths and sort specs of a table that had more.
+        const auto *table = m_data->table();
+        const auto columns = column_count();
+        if(ImGui::BeginTable(fmt::format("#itemslist{}_{}", m_window_id, columns).c_str(), static_cast<int>(columns), ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable | ImGuiTableFlags_SortTristate | ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV)) {
+          ImGui::TableSetupScrollFreeze(0, 1);
+          if(table != nullptr) {
+            for(const auto &column : table->schema().columns) {
+              ImGui::TableSetupColumn(column.name.c_str(), column.type == ColumnType::STRING ? ImGuiTableColumnFlags_WidthStretch : ImGuiTableColumnFlags_WidthFixed, column.type == ColumnType::STRING ? 0.0F : ITEM_COLUMN_WIDTH);
+            }
+          } else {
+            ImGui::TableSetupColumn("Item");
+          }
+          ImGui::TableHeadersRow();
+          update_sort_order();
+
+          ImGuiListClipper clipper;
+          clipper.Begin(static_cast<int>(row_count()));
+          while(clipper.Step()) {
+            for(auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+              ImGui::TableNextRow();
+              if(table != nullptr) {
+                render_cells(static_cast<size_t>(row));
+              } else {
+                ImGui::TableSetColumnIndex(0);
+                render_row(static_cast<size_t>(row));
+              }
+            }
           }
           ImGui::EndTable();
         }
@@ -0,0 +1,60 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mv {
+  /**
+   * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+   *
+   * The capacity is rounded up to a power of two. try_push() fails when the queue is full, it's up
+   * to the producer to back off.
+   */
+  template <typename T>
+  class SpscQueue {
+    public:
+      explicit SpscQueue(size_t capacity) : m_slots(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask(m_slots.size() - 1) {}
+
+      bool try_push(T &&value) {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if(head - m_tail.load(std::memory_order_acquire) == m_slots.size()) {
+          return false;
+        }
+        m_slots[head & m_mask] = std::move(value);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+      }
+
+      bool try_pop(T &value) {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        if(tail == m_head.load(std::memory_order_acquire)) {
+          return false;
+        }
+        value = std::move(m_slots[tail & m_mask]);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+      }
+
+      // Approximate when called while the other side is active
+      [[nodiscard]] size_t size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+      }
+
+      [[nodiscard]] size_t capacity() const {
+        return m_slots.size();
+      }
+
+    private:
+      std::vector<T> m_slots;
+      size_t m_mask;
+      alignas(64) std::atomic<size_t> m_head{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      alignas(64) std::atomic<size_t> m_tail{0};// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+  };
+}// namespace mv
\ No newline at end of file
@@ -0,0 +1,281 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "ItemStore.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MV_STRING_MATCH_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Substring, prefix and ASCII case insensitive matching over item text.
+ *
+ * The vector kernels compare a block of positions at once against the first and the last byte of
+ * the needle and only look closer at the positions where both match (the "generic SIMD" search by
+ * Wojciech Muła). With ignore case, letters are compared with bit 5 set, which folds A-Z onto a-z
+ * and nothing else onto a letter. The best kernel the CPU supports is picked at runtime, other
+ * platforms get the scalar one.
+ *
+ * for_each_match() scans the text of a whole chunk instead of one item at a time. Needles can't
+ * contain '\0' so a match never spans two items.
+ */
+namespace mv::match {
+  enum Isa {
+    SCALAR,
+    SSE42,
+    AVX2,
+    ISA_COUNT
+  };
+
+  constexpr std::array<const char *, ISA_COUNT> ISA_NAMES = {"scalar", "SSE4.2", "AVX2"};
+
+  constexpr char to_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  }
+
+  constexpr bool is_lower_alpha(char c) {
+    return c >= 'a' && c <= 'z';
+  }
+
+  // The needle must be lower case
+  inline bool equal_ignore_case(const char *text, const char *needle, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+      if(to_lower(text[i]) != needle[i]) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <bool IGNORE_CASE>
+  inline bool equal(const char *text, const char *needle, size_t length) {
+    if constexpr(IGNORE_CASE) {
+      return equal_ignore_case(text, needle, length);
+    } else {
+      return std::memcmp(text, needle, length) == 0;
+    }
+  }
+
+  template <bool IGNORE_CASE>
+  inline size_t find_scalar(const char *text, size_t size, const char *needle, size_t length) {
+    if constexpr(!IGNORE_CASE) {
+      return std::string_view{text, size}.find(std::string_view{needle, length});
+    } else {
+      if(length > size) {
+        return std::string_view::npos;
+      }
+      for(size_t i = 0; i + length <= size; i++) {
+        if(to_lower(text[i]) == needle[0] && equal_ignore_case(text + i, needle, length)) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          return i;
+        }
+      }
+      return std::string_view::npos;
+    }
+  }
+
+#ifdef MV_STRING_MATCH_X86
+  // OR-ed into the text before comparing with a lower case letter of the needle
+  template <bool IGNORE_CASE>
+  constexpr char fold_bit(char c) {
+    return IGNORE_CASE && is_lower_alpha(c) ? 0x20 : 0;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+  }
+
+  template <bool IGNORE_CASE>
+  __attribute__((target("sse4.2"))) inline size_t find_sse42(const char *text, size_t size, const char *needle, size_t length) {
+    static constexpr size_t BLOCK = 16;
+    if(length == 0 || length > size) {
+      return length == 0 ? 0 : std::string_view::npos;
+    }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[length - 1]);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    const __m128i fold_first = _mm_set1_epi8(fold_bit<IGNORE_CASE>(needle[0]));
+    const __m128i fold_last = _mm_set1_epi8(fold_bit<IGNORE_CASE>(needle[length - 1]));// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+
+    size_t i = 0;
+    for(; i + length - 1 + BLOCK <= size; i += BLOCK) {
+      const __m128i block_first = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i)), fold_first);// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+      const __m128i block_last = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + length - 1)), fold_last);// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+      while(mask != 0) {
+        const auto bit = static_cast<size_t>(std::countr_zero(mask));
+        if(length <= 2 || equal<IGNORE_CASE>(text + i + bit + 1, needle + 1, length - 2)) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          return i + bit;
+        }
+        mask &= mask - 1;
+      }
+    }
+    const auto rest = find_scalar<IGNORE_CASE>(text + i, size - i, needle, length);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    return rest == std::string_view::npos ? rest : i + rest;
+  }
+
+  template <bool IGNORE_CASE>
+  __attribute__((target("avx2"))) inline size_t find_avx2(const char *text, size_t size, const char *needle, size_t length) {
+    static constexpr size_t BLOCK = 32;
+    if(length == 0 || length > size) {
+      return length == 0 ? 0 : std::string_view::npos;
+    }
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[length - 1]);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    const __m256i fold_first = _mm256_set1_epi8(fold_bit<IGNORE_CASE>(needle[0]));
+    const __m256i fold_last = _mm256_set1_epi8(fold_bit<IGNORE_CASE>(needle[length - 1]));// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+
+    size_t i = 0;
+    for(; i + length - 1 + BLOCK <= size; i += BLOCK) {
+      const __m256i block_first = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i)), fold_first);// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+      const __m256i block_last = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + length - 1)), fold_last);// NOLINT: cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+      while(mask != 0) {
+        const auto bit = static_cast<size_t>(std::countr_zero(mask));
+        if(length <= 2 || equal<IGNORE_CASE>(text + i + bit + 1, needle + 1, length - 2)) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+          return i + bit;
+        }
+        mask &= mask - 1;
+      }
+    }
+    const auto rest = find_sse42<IGNORE_CASE>(text + i, size - i, needle, length);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    return rest == std::string_view::npos ? rest : i + rest;
+  }
+#endif
+
+  using FindFn = size_t (*)(const char *, size_t, const char *, size_t);
+
+  struct Kernels {
+    Isa isa;
+    FindFn find;
+    FindFn find_ignore_case;
+  };
+
+  inline Isa best_isa() {
+#ifdef MV_STRING_MATCH_X86
+    static const Isa isa = __builtin_cpu_supports("avx2") ? AVX2 : (__builtin_cpu_supports("sse4.2") ? SSE42 : SCALAR);
+    return isa;
+#else
+    return SCALAR;
+#endif
+  }
+
+  inline Kernels kernels_for(Isa isa) {
+    isa = std::min(isa, best_isa());
+    switch(isa) {
+#ifdef MV_STRING_MATCH_X86
+    case AVX2:
+      return {AVX2, find_avx2<false>, find_avx2<true>};
+    case SSE42:
+      return {SSE42, find_sse42<false>, find_sse42<true>};
+#endif
+    default:
+      return {SCALAR, find_scalar<false>, find_scalar<true>};
+    }
+  }
+
+  inline Kernels &active_kernels() {
+    static Kernels kernels = kernels_for(best_isa());
+    return kernels;
+  }
+
+  // Falls back to the best supported kernel below isa, for benchmarks. Not thread safe.
+  inline void use_isa(Isa isa) {
+    active_kernels() = kernels_for(isa);
+  }
+
+  inline Isa active_isa() {
+    return active_kernels().isa;
+  }
+
+  // Position of the first occurrence of needle, npos if none. With ignore_case the needle must be lower case.
+  inline size_t find(std::string_view text, std::string_view needle, bool ignore_case = false) {
+    const auto &kernels = active_kernels();
+    return (ignore_case ? kernels.find_ignore_case : kernels.find)(text.data(), text.size(), needle.data(), needle.size());
+  }
+
+  class Pattern {
+    public:
+      Pattern() = default;
+      Pattern(std::string_view needle, bool ignore_case, bool prefix) : m_needle(needle), m_ignore_case(ignore_case), m_prefix(prefix) {
+        if(m_ignore_case) {
+          std::transform(m_needle.begin(), m_needle.end(), m_needle.begin(), to_lower);
+        }
+        // A prefix match in chunk text is the needle right after the '\0' ending the previous item
+        m_search = m_prefix ? std::string(1, '\0') + m_needle : m_needle;
+      }
+
+      [[nodiscard]] const std::string &needle() const {
+        return m_needle;
+      }
+
+      [[nodiscard]] bool ignore_case() const {
+        return m_ignore_case;
+      }
+
+      [[nodiscard]] bool prefix() const {
+        return m_prefix;
+      }
+
+      [[nodiscard]] bool matches(std::string_view item) const {
+        if(m_prefix) {
+          return item.size() >= m_needle.size() && (m_ignore_case ? equal_ignore_case(item.data(), m_needle.data(), m_needle.size()) : item.starts_with(m_needle));
+        }
+        return match::find(item, m_needle, m_ignore_case) != std::string_view::npos;
+      }
+
+      // Calls visit(index) for every matching item with an index in [begin, end) of the chunk, in order
+      template <typename Visit>
+      void for_each_match(const ItemStore::Chunk &chunk, uint32_t begin, uint32_t end, Visit &&visit) const {
+        if(begin >= end) {
+          return;
+        }
+        if(m_needle.empty()) {
+          for(auto i = begin; i < end; i++) {
+            visit(i);
+          }
+          return;
+        }
+
+        const auto offsets = chunk.offsets(end);
+        const auto text = chunk.text(end);
+        if(m_prefix && begin == 0) {
+          if(matches(chunk[0])) {
+            visit(0U);
+          }
+          begin = 1;
+        }
+
+        // With prefix the search starts at the '\0' in front of the first item
+        const size_t lead = m_prefix ? 1 : 0;
+        auto pos = offsets[begin] - lead;
+        const auto stop = offsets[end];
+        auto item = begin;
+        while(pos < stop) {
+          const auto found = match::find(text.substr(pos, stop - pos), m_search, m_ignore_case);
+          if(found == std::string_view::npos) {
+            break;
+          }
+          const auto start = static_cast<uint32_t>(pos + found + lead);
+          // Matches tend to be close together, check the item the search started in before searching
+          if(start >= offsets[item + 1]) {
+            item = static_cast<uint32_t>(std::upper_bound(offsets.begin() + item + 1, offsets.begin() + end, start) - offsets.begin()) - 1;
+          }
+          visit(item);
+          ++item;
+          pos = offsets[item] - lead;
+        }
+      }
+
+    private:
+      std::string m_needle;
+      std::string m_search;
+      bool m_ignore_case{false};
+      bool m_prefix{false};
+  };
+}// namespace mv::match
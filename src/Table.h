@@ -0,0 +1,575 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "ItemStore.h"
+
+namespace mv {
+  enum class ColumnType {
+    INT64,
+    DOUBLE,
+    // Microseconds since the epoch (UTC), parsed from and shown as "YYYY-MM-DD HH:MM:SS.ffffff"
+    TIMESTAMP,
+    STRING,
+    // A string out of a small set, stored as a code
+    ENUM
+  };
+
+  struct ColumnSpec {
+    std::string name;
+    ColumnType type;
+  };
+
+  /**
+   * The columns of delimiter separated item lines. Fields are split at every delimiter, quoting
+   * isn't supported.
+   */
+  struct Schema {
+    // ImGui tables can't have more
+    static constexpr size_t MAX_COLUMNS = 64;
+    // A column is an enum when a sample of this many lines has at most MAX_ENUM_SAMPLE_VALUES
+    // different values
+    static constexpr size_t MIN_ENUM_SAMPLE_LINES = 32;
+    static constexpr size_t MAX_ENUM_SAMPLE_VALUES = 16;
+    // Bytes read from a file to infer its schema
+    static constexpr size_t SAMPLE_BYTES = 1U << 16U;
+
+    char delimiter{'\t'};
+    std::vector<ColumnSpec> columns;
+
+    // Column names from the header line, the types from a sample of the lines that follow
+    static Schema infer(std::string_view header, std::span<const std::string_view> lines, char delimiter);
+
+    // The schema of a .csv or .tsv file with a header line, nullopt for other files
+    static std::optional<Schema> of_file(const std::filesystem::path &path);
+  };
+
+  // Calls visit(index, field) for the fields of a line
+  template <typename Visit>
+  inline void for_each_field(std::string_view line, char delimiter, Visit &&visit) {
+    size_t index = 0;
+    while(true) {
+      const auto end = line.find(delimiter);
+      visit(index++, line.substr(0, end));
+      if(end == std::string_view::npos) {
+        return;
+      }
+      line.remove_prefix(end + 1);
+    }
+  }
+
+  inline std::string_view field(std::string_view line, char delimiter, size_t index) {
+    for(; index > 0; index--) {
+      const auto end = line.find(delimiter);
+      if(end == std::string_view::npos) {
+        return {};
+      }
+      line.remove_prefix(end + 1);
+    }
+    return line.substr(0, line.find(delimiter));
+  }
+
+  inline std::optional<int64_t> parse_int64(std::string_view text) {
+    int64_t value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    if(error != std::errc{} || end != text.data() + text.size() || text.empty()) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  inline std::optional<double> parse_double(std::string_view text) {
+    double value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    if(error != std::errc{} || end != text.data() + text.size() || text.empty()) {// NOLINT: cppcoreguidelines-pro-bounds-pointer-arithmetic
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // "YYYY-MM-DD", optionally followed by "[T ]HH:MM[:SS[.fraction]]" and "Z"
+  inline std::optional<int64_t> parse_timestamp(std::string_view text) {
+    static constexpr size_t DATE_LENGTH = 10;
+    static constexpr size_t MINUTES_END = 16;
+    static constexpr size_t SECONDS_END = 19;
+    static constexpr int MICROSECOND_DIGITS = 6;
+    const auto number = [text](size_t pos, size_t length) -> std::optional<int> {
+      if(pos + length > text.size()) {
+        return std::nullopt;
+      }
+      auto value = parse_int64(text.substr(pos, length));
+      return value && *value >= 0 ? std::optional<int>{static_cast<int>(*value)} : std::nullopt;
+    };
+
+    if(text.ends_with('Z')) {
+      text.remove_suffix(1);
+    }
+    if(text.size() < DATE_LENGTH || text[4] != '-' || text[7] != '-') {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      return std::nullopt;
+    }
+    const auto year = number(0, 4);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    const auto month = number(5, 2);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    const auto day = number(8, 2);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    if(!year || !month || !day) {
+      return std::nullopt;
+    }
+    const std::chrono::year_month_day date{std::chrono::year{*year}, std::chrono::month{static_cast<unsigned>(*month)}, std::chrono::day{static_cast<unsigned>(*day)}};
+    if(!date.ok()) {
+      return std::nullopt;
+    }
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::sys_days{date}.time_since_epoch());
+    if(text.size() == DATE_LENGTH) {
+      return time.count();
+    }
+
+    if((text[DATE_LENGTH] != 'T' && text[DATE_LENGTH] != ' ') || text.size() < MINUTES_END || text[13] != ':') {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      return std::nullopt;
+    }
+    const auto hours = number(11, 2);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    const auto minutes = number(14, 2);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    if(!hours || !minutes || *hours > 23 || *minutes > 59) {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      return std::nullopt;
+    }
+    time += std::chrono::hours{*hours} + std::chrono::minutes{*minutes};
+    if(text.size() == MINUTES_END) {
+      return time.count();
+    }
+
+    const auto seconds = text[MINUTES_END] == ':' ? number(MINUTES_END + 1, 2) : std::nullopt;
+    if(!seconds || *seconds > 60) {// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      return std::nullopt;
+    }
+    time += std::chrono::seconds{*seconds};
+    if(text.size() == SECONDS_END) {
+      return time.count();
+    }
+
+    if(text[SECONDS_END] != '.' || text.size() == SECONDS_END + 1) {
+      return std::nullopt;
+    }
+    int64_t fraction = 0;
+    int digits = 0;
+    for(const auto c : text.substr(SECONDS_END + 1)) {
+      if(c < '0' || c > '9') {
+        return std::nullopt;
+      }
+      if(digits++ < MICROSECOND_DIGITS) {
+        fraction = fraction * 10 + (c - '0');// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+      }
+    }
+    for(; digits < MICROSECOND_DIGITS; digits++) {
+      fraction *= 10;// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+    }
+    return time.count() + fraction;
+  }
+
+  inline void format_timestamp(fmt::memory_buffer &out, int64_t microseconds) {
+    const std::chrono::sys_time<std::chrono::microseconds> time{std::chrono::microseconds{microseconds}};
+    const auto days = std::chrono::floor<std::chrono::days>(time);
+    const std::chrono::year_month_day date{days};
+    const std::chrono::hh_mm_ss clock{time - days};
+    fmt::format_to(std::back_inserter(out), "{:04}-{:02}-{:02} {:02}:{:02}:{:02}.{:06}", static_cast<int>(date.year()), static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()), clock.hours().count(), clock.minutes().count(), clock.seconds().count(), clock.subseconds().count());
+  }
+
+  inline Schema Schema::infer(std::string_view header, std::span<const std::string_view> lines, char delimiter) {
+    Schema schema;
+    schema.delimiter = delimiter;
+    for_each_field(header, delimiter, [&schema](size_t /*index*/, std::string_view name) {
+      if(schema.columns.size() < MAX_COLUMNS) {
+        schema.columns.push_back({std::string{name}, ColumnType::INT64});
+      }
+    });
+
+    for(size_t column = 0; column < schema.columns.size(); column++) {
+      bool ints = true;
+      bool doubles = true;
+      bool timestamps = true;
+      std::vector<std::string_view> values;
+      for(const auto line : lines) {
+        const auto value = field(line, delimiter, column);
+        if(value.empty()) {
+          continue;
+        }
+        ints = ints && parse_int64(value).has_value();
+        doubles = doubles && parse_double(value).has_value();
+        timestamps = timestamps && parse_timestamp(value).has_value();
+        if(values.size() <= MAX_ENUM_SAMPLE_VALUES && std::find(values.begin(), values.end(), value) == values.end()) {
+          values.push_back(value);
+        }
+      }
+
+      auto &type = schema.columns[column].type;
+      if(values.empty()) {
+        type = ColumnType::STRING;
+      } else if(ints) {
+        type = ColumnType::INT64;
+      } else if(doubles) {
+        type = ColumnType::DOUBLE;
+      } else if(timestamps) {
+        type = ColumnType::TIMESTAMP;
+      } else if(lines.size() >= MIN_ENUM_SAMPLE_LINES && values.size() <= MAX_ENUM_SAMPLE_VALUES) {
+        type = ColumnType::ENUM;
+      } else {
+        type = ColumnType::STRING;
+      }
+    }
+    return schema;
+  }
+
+  inline std::optional<Schema> Schema::of_file(const std::filesystem::path &path) {
+    const auto extension = path.extension();
+    if(extension != ".csv" && extension != ".tsv") {
+      return std::nullopt;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::string sample(SAMPLE_BYTES, '\0');
+    file.read(sample.data(), static_cast<std::streamsize>(sample.size()));
+    sample.resize(static_cast<size_t>(file.gcount()));
+
+    // Complete lines only, without a trailing '\r'
+    std::vector<std::string_view> lines;
+    std::string_view rest{sample};
+    for(auto end = rest.find('\n'); end != std::string_view::npos; end = rest.find('\n')) {
+      auto line = rest.substr(0, end);
+      if(line.ends_with('\r')) {
+        line.remove_suffix(1);
+      }
+      lines.push_back(line);
+      rest.remove_prefix(end + 1);
+    }
+    if(lines.empty()) {
+      return std::nullopt;
+    }
+    return infer(lines.front(), std::span{lines}.subspan(1), extension == ".csv" ? ',' : '\t');
+  }
+
+  /**
+   * Append-only array of values in chunks, shared the same way as ItemStore chunks: snapshots read
+   * the values that existed when they were taken while more are appended, and copies share the
+   * chunks until they append (copy on write of the last chunk).
+   */
+  template <typename T>
+  class ColumnData {
+    public:
+      static constexpr size_t CHUNK_VALUES = 1U << 16U;
+      using Chunk = std::array<T, CHUNK_VALUES>;
+
+      class Snapshot {
+        public:
+          [[nodiscard]] size_t size() const {
+            return m_size;
+          }
+
+          [[nodiscard]] T operator[](size_t index) const {
+            return (*m_chunks[index / CHUNK_VALUES])[index % CHUNK_VALUES];
+          }
+
+        private:
+          friend class ColumnData;
+
+          std::vector<std::shared_ptr<const Chunk>> m_chunks;
+          size_t m_size{0};
+      };
+
+      ColumnData() = default;
+      ~ColumnData() = default;
+
+      ColumnData(const ColumnData &other) : m_chunks(other.m_chunks), m_size(other.m_size) {}
+
+      ColumnData(ColumnData &&other) noexcept
+        : m_chunks(std::move(other.m_chunks)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_owns_tail(std::exchange(other.m_owns_tail, false)) {
+      }
+
+      ColumnData &operator=(const ColumnData &) = delete;
+      ColumnData &operator=(ColumnData &&) = delete;
+
+      void push_back(T value) {
+        if(m_size % CHUNK_VALUES == 0) {
+          m_chunks.push_back(std::make_shared<Chunk>());
+          m_owns_tail = true;
+        } else if(!m_owns_tail) {
+          m_chunks.back() = std::make_shared<Chunk>(*m_chunks.back());
+          m_owns_tail = true;
+        }
+        (*m_chunks.back())[m_size % CHUNK_VALUES] = value;
+        ++m_size;
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_size;
+      }
+
+      [[nodiscard]] T operator[](size_t index) const {
+        return (*m_chunks[index / CHUNK_VALUES])[index % CHUNK_VALUES];
+      }
+
+      [[nodiscard]] Snapshot snapshot() const {
+        Snapshot snapshot;
+        snapshot.m_chunks = {m_chunks.begin(), m_chunks.end()};
+        snapshot.m_size = m_size;
+        return snapshot;
+      }
+
+      [[nodiscard]] size_t memory_usage() const {
+        return m_chunks.size() * sizeof(Chunk);
+      }
+
+    private:
+      std::vector<std::shared_ptr<Chunk>> m_chunks;
+      size_t m_size{0};
+      bool m_owns_tail{false};
+  };
+
+  /**
+   * Typed, column-wise view of the items of a dataset: item i is row i, its fields are parsed once
+   * when it's added. Numbers and timestamps are stored as such (and formatted only when a cell is
+   * shown), enums as codes into a dictionary. String fields aren't copied, they're read from the
+   * item text.
+   *
+   * Sorting and aggregates walk a contiguous array of one column instead of parsing text.
+   */
+  class Table {
+    public:
+      // Running aggregates of a numeric column, missing values don't count
+      struct Stats {
+        size_t count{0};
+        double min{std::numeric_limits<double>::infinity()};
+        double max{-std::numeric_limits<double>::infinity()};
+        double sum{0.0};
+
+        [[nodiscard]] double mean() const {
+          return count == 0 ? 0.0 : sum / static_cast<double>(count);
+        }
+      };
+
+      // What sorting by one column needs, a snapshot that can be used on other threads
+      class SortColumn {
+        public:
+          // Order preserving key of the value in a row, missing values first. For string columns
+          // the key is the first 8 bytes and text is set to the field, for the rest text is empty.
+          [[nodiscard]] uint64_t key(const ItemStore::Snapshot &items, size_t row, std::string_view &text) const {
+            switch(m_type) {
+            case ColumnType::INT64:
+            case ColumnType::TIMESTAMP:
+              return std::bit_cast<uint64_t>(m_ints[row]) ^ SIGN_BIT;
+            case ColumnType::DOUBLE: {
+              const auto value = m_doubles[row];
+              if(std::isnan(value)) {
+                return 0;
+              }
+              const auto bits = std::bit_cast<uint64_t>(value);
+              return (bits & SIGN_BIT) != 0 ? ~bits : bits | SIGN_BIT;
+            }
+            case ColumnType::ENUM:
+              return m_ranks[m_codes[row]];
+            case ColumnType::STRING:
+              break;
+            }
+            text = field(items[row], m_delimiter, m_index);
+            uint64_t prefix = 0;
+            for(size_t i = 0; i < sizeof(prefix); i++) {
+              prefix = (prefix << 8U) | (i < text.size() ? static_cast<uint8_t>(text[i]) : 0U);// NOLINT: cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers
+            }
+            return prefix;
+          }
+
+        private:
+          friend class Table;
+
+          static constexpr uint64_t SIGN_BIT = 1ULL << 63U;
+
+          ColumnType m_type{ColumnType::STRING};
+          char m_delimiter{'\t'};
+          size_t m_index{0};
+          ColumnData<int64_t>::Snapshot m_ints;
+          ColumnData<double>::Snapshot m_doubles;
+          ColumnData<uint32_t>::Snapshot m_codes;
+          // Position of every enum code in the sorted dictionary
+          std::vector<uint32_t> m_ranks;
+      };
+
+      static constexpr int64_t MISSING = std::numeric_limits<int64_t>::min();
+
+      explicit Table(Schema schema) : m_schema(std::move(schema)), m_columns(m_schema.columns.size()) {}
+
+      [[nodiscard]] const Schema &schema() const {
+        return m_schema;
+      }
+
+      [[nodiscard]] size_t size() const {
+        return m_rows;
+      }
+
+      // Parses the items that aren't rows yet until the budget is spent
+      void update(const ItemStore &items, std::chrono::nanoseconds budget) {
+        static constexpr size_t ROWS_PER_CLOCK_CHECK = 256;
+        const auto start = std::chrono::steady_clock::now();
+        while(m_rows < items.size()) {
+          const auto end = std::min(items.size(), m_rows + ROWS_PER_CLOCK_CHECK);
+          for(; m_rows < end; m_rows++) {
+            append_row(items[m_rows]);
+          }
+          if(std::chrono::steady_clock::now() - start >= budget) {
+            break;
+          }
+        }
+      }
+
+      [[nodiscard]] static bool is_numeric(ColumnType type) {
+        return type == ColumnType::INT64 || type == ColumnType::DOUBLE;
+      }
+
+      [[nodiscard]] const Stats &stats(size_t column) const {
+        return m_columns[column].stats;
+      }
+
+      // The text of a cell, numbers and timestamps are formatted into buffer
+      [[nodiscard]] std::string_view cell(const ItemStore &items, size_t row, size_t column, fmt::memory_buffer &buffer) const {
+        const auto &data = m_columns[column];
+        buffer.clear();
+        switch(m_schema.columns[column].type) {
+        case ColumnType::INT64:
+          if(data.ints[row] != MISSING) {
+            fmt::format_to(std::back_inserter(buffer), "{}", data.ints[row]);
+          }
+          break;
+        case ColumnType::DOUBLE:
+          if(!std::isnan(data.doubles[row])) {
+            fmt::format_to(std::back_inserter(buffer), "{:.6g}", data.doubles[row]);
+          }
+          break;
+        case ColumnType::TIMESTAMP:
+          if(data.ints[row] != MISSING) {
+            format_timestamp(buffer, data.ints[row]);
+          }
+          break;
+        case ColumnType::ENUM:
+          return data.dictionary[data.codes[row]];
+        case ColumnType::STRING:
+          return field(items[row], m_schema.delimiter, column);
+        }
+        return {buffer.data(), buffer.size()};
+      }
+
+      [[nodiscard]] SortColumn sort_column(size_t column) const {
+        const auto &data = m_columns[column];
+        SortColumn sort;
+        sort.m_type = m_schema.columns[column].type;
+        sort.m_delimiter = m_schema.delimiter;
+        sort.m_index = column;
+        sort.m_ints = data.ints.snapshot();
+        sort.m_doubles = data.doubles.snapshot();
+        sort.m_codes = data.codes.snapshot();
+        if(sort.m_type == ColumnType::ENUM) {
+          std::vector<uint32_t> order(data.dictionary.size());
+          std::iota(order.begin(), order.end(), 0U);
+          std::sort(order.begin(), order.end(), [&data](uint32_t a, uint32_t b) { return data.dictionary[a] < data.dictionary[b]; });
+          sort.m_ranks.resize(order.size());
+          for(uint32_t rank = 0; rank < order.size(); rank++) {
+            sort.m_ranks[order[rank]] = rank;
+          }
+        }
+        return sort;
+      }
+
+      [[nodiscard]] size_t memory_usage() const {
+        size_t bytes = sizeof(Table);
+        for(const auto &column : m_columns) {
+          bytes += column.ints.memory_usage() + column.doubles.memory_usage() + column.codes.memory_usage();
+        }
+        return bytes;
+      }
+
+    private:
+      struct Column {
+        ColumnData<int64_t> ints;
+        ColumnData<double> doubles;
+        ColumnData<uint32_t> codes;
+        std::vector<std::string> dictionary;
+        std::map<std::string, uint32_t, std::less<>> codes_by_value;
+        Stats stats;
+      };
+
+      Schema m_schema;
+      std::vector<Column> m_columns;
+      size_t m_rows{0};
+
+      void append_row(std::string_view line) {
+        std::array<std::string_view, Schema::MAX_COLUMNS> fields{};
+        for_each_field(line, m_schema.delimiter, [&fields](size_t index, std::string_view value) {
+          if(index < fields.size()) {
+            fields.at(index) = value;
+          }
+        });
+
+        for(size_t i = 0; i < m_columns.size(); i++) {
+          auto &column = m_columns[i];
+          const auto value = fields.at(i);
+          switch(m_schema.columns[i].type) {
+          case ColumnType::INT64: {
+            const auto number = parse_int64(value);
+            column.ints.push_back(number.value_or(MISSING));
+            if(number) {
+              add_to_stats(column.stats, static_cast<double>(*number));
+            }
+            break;
+          }
+          case ColumnType::DOUBLE: {
+            const auto number = parse_double(value);
+            column.doubles.push_back(number.value_or(std::numeric_limits<double>::quiet_NaN()));
+            if(number && !std::isnan(*number)) {
+              add_to_stats(column.stats, *number);
+            }
+            break;
+          }
+          case ColumnType::TIMESTAMP:
+            column.ints.push_back(parse_timestamp(value).value_or(MISSING));
+            break;
+          case ColumnType::ENUM: {
+            auto it = column.codes_by_value.find(value);
+            if(it == column.codes_by_value.end()) {
+              it = column.codes_by_value.emplace(std::string{value}, static_cast<uint32_t>(column.dictionary.size())).first;
+              column.dictionary.emplace_back(value);
+            }
+            column.codes.push_back(it->second);
+            break;
+          }
+          case ColumnType::STRING:
+            break;
+          }
+        }
+      }
+
+      static void add_to_stats(Stats &stats, double value) {
+        ++stats.count;
+        stats.min = std::min(stats.min, value);
+        stats.max = std::max(stats.max, value);
+        stats.sum += value;
+      }
+  };
+}// namespace mv
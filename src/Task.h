@@ -0,0 +1,356 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "MainThreadQueue.h"
+#include "ThreadPool.h"
+#include "Window.h"
+
+/**
+ * Coroutines for windows that do something in the background, written as one function:
+ *
+ *   Task<> SomeWindow::load(std::string path) {
+ *     co_await resume_on_pool();
+ *     auto data = read(path);     // on a worker
+ *     co_await resume_on_ui();
+ *     publish(std::move(data));   // on the main thread, at the start of a frame
+ *   }
+ *
+ *   m_app.tasks().spawn(*this, load(path));
+ *
+ * A Task doesn't run until it's spawned or awaited, awaiting one runs it on the awaiting thread
+ * and gives its result (or rethrows its exception). Spawned tasks belong to a window: when the
+ * window closes the task is cancelled, it's destroyed at its next co_await resume_on_...() instead
+ * of being resumed, so code after a hop never runs for a window that's gone. Long loops on a
+ * worker can check co_await stop_token() to stop early.
+ */
+namespace mv {
+  class TaskContext;
+  class TaskRunner;
+
+  namespace detail {
+    struct PoolAwaiter;
+    struct UiAwaiter;
+
+    struct PromiseBase {
+      // Of the spawned task, shared by the tasks it awaits
+      TaskContext *context{nullptr};
+      // Resumed when this task is done, null for a spawned task
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+
+      struct FinalAwaiter {
+        [[nodiscard]] bool await_ready() const noexcept {
+          return false;
+        }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+        void await_resume() const noexcept {}
+      };
+
+      [[nodiscard]] std::suspend_always initial_suspend() const noexcept {
+        return {};
+      }
+
+      [[nodiscard]] FinalAwaiter final_suspend() const noexcept {
+        return {};
+      }
+
+      void unhandled_exception() {
+        error = std::current_exception();
+      }
+    };
+
+    template <typename T>
+    struct Promise : PromiseBase {
+      std::optional<T> value;
+
+      template <typename U>
+      void return_value(U &&result) {
+        value.emplace(std::forward<U>(result));
+      }
+
+      T result() {
+        if(error) {
+          std::rethrow_exception(error);
+        }
+        return std::move(*value);
+      }
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase {
+      void return_void() const {}
+
+      void result() const {
+        if(error) {
+          std::rethrow_exception(error);
+        }
+      }
+    };
+  }// namespace detail
+
+  template <typename T = void>
+  class [[nodiscard]] Task {
+    public:
+      struct promise_type : detail::Promise<T> {
+        Task get_return_object() {
+          return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+      };
+
+      Task() = default;
+      Task(const Task &) = delete;
+      Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+      Task &operator=(const Task &) = delete;
+      Task &operator=(Task &&other) noexcept {
+        if(this != &other) {
+          reset();
+          m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+      }
+
+      ~Task() {
+        reset();
+      }
+
+      // Runs the task on the awaiting thread, with the awaiting task's context
+      auto operator co_await() &&noexcept {
+        return Awaiter{m_handle};
+      }
+
+    private:
+      friend class TaskRunner;
+
+      struct Awaiter {
+        std::coroutine_handle<promise_type> handle;
+
+        [[nodiscard]] bool await_ready() const noexcept {
+          return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) noexcept {
+          handle.promise().context = awaiting.promise().context;
+          handle.promise().continuation = awaiting;
+          return handle;
+        }
+
+        T await_resume() {
+          return handle.promise().result();
+        }
+      };
+
+      std::coroutine_handle<promise_type> m_handle;
+
+      explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+      void reset() {
+        if(m_handle) {
+          m_handle.destroy();
+          m_handle = nullptr;
+        }
+      }
+  };
+
+  /**
+   * State of a spawned task. Everything but the stop flag is only touched on the main thread.
+   */
+  class TaskContext {
+    public:
+      TaskContext(ThreadPool &pool, MainThreadQueue &queue, const Window &owner) : m_pool(pool), m_queue(queue), m_owner(&owner), m_lifetime(owner.lifetime()) {}
+
+      [[nodiscard]] std::stop_token stop_token() const {
+        return m_stop.get_token();
+      }
+
+      [[nodiscard]] bool cancelled() const {
+        return m_stop.stop_requested();
+      }
+
+    private:
+      friend class TaskRunner;
+      friend struct detail::PromiseBase;
+      friend struct detail::PoolAwaiter;
+      friend struct detail::UiAwaiter;
+
+      ThreadPool &m_pool;
+      MainThreadQueue &m_queue;
+      const Window *m_owner;
+      std::weak_ptr<const void> m_lifetime;
+      std::stop_source m_stop;
+      Task<> m_root;
+      // Set when the spawned task is done (on whichever thread it ended)
+      std::atomic<bool> m_finished{false};
+      bool m_destroyed{false};
+
+      // Main thread only
+      [[nodiscard]] bool owner_closed() const {
+        return m_lifetime.expired() || m_owner->should_close();
+      }
+
+      // Main thread only, the task is suspended at a hop
+      void destroy() {
+        m_root = Task<>{};
+        m_destroyed = true;
+      }
+
+      // A cancelled task is destroyed instead, always on the main thread
+      void resume_on_pool(std::coroutine_handle<> handle) {
+        m_pool.submit([this, handle] {
+          if(cancelled()) {
+            m_queue.post([this] { destroy(); });
+            return;
+          }
+          handle.resume();
+        });
+      }
+
+      void resume_on_ui(std::coroutine_handle<> handle) {
+        m_queue.post([this, handle] {
+          if(cancelled() || owner_closed()) {
+            destroy();
+            return;
+          }
+          handle.resume();
+        });
+      }
+  };
+
+  template <typename Promise>
+  std::coroutine_handle<> detail::PromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    auto &promise = handle.promise();
+    if(promise.continuation) {
+      return promise.continuation;
+    }
+    // The runner destroys the frame on the main thread, nothing here may touch it afterwards
+    promise.context->m_finished.store(true, std::memory_order_release);
+    return std::noop_coroutine();
+  }
+
+  namespace detail {
+    struct PoolAwaiter {
+      [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+      }
+      template <typename Promise>
+      void await_suspend(std::coroutine_handle<Promise> handle) const {
+        assert(handle.promise().context != nullptr);
+        handle.promise().context->resume_on_pool(handle);
+      }
+      void await_resume() const noexcept {}
+    };
+
+    struct UiAwaiter {
+      [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+      }
+      template <typename Promise>
+      void await_suspend(std::coroutine_handle<Promise> handle) const {
+        assert(handle.promise().context != nullptr);
+        handle.promise().context->resume_on_ui(handle);
+      }
+      void await_resume() const noexcept {}
+    };
+
+    struct StopTokenAwaiter {
+      std::stop_token token;
+
+      [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+      }
+      // Doesn't suspend, only picks up the token
+      template <typename Promise>
+      bool await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        token = handle.promise().context->stop_token();
+        return false;
+      }
+      std::stop_token await_resume() const noexcept {
+        return token;
+      }
+    };
+  }// namespace detail
+
+  // co_await resume_on_pool(): the rest of the task runs on a worker of the thread pool
+  inline detail::PoolAwaiter resume_on_pool() {
+    return {};
+  }
+
+  // co_await resume_on_ui(): the rest of the task runs on the main thread at the start of a frame
+  inline detail::UiAwaiter resume_on_ui() {
+    return {};
+  }
+
+  // co_await stop_token(): stop requested when the owner window closes
+  inline detail::StopTokenAwaiter stop_token() {
+    return {};
+  }
+
+  /**
+   * The spawned tasks of all windows, owned by the application. update() runs at the start of
+   * every frame before the main thread queue is drained: it cancels the tasks of closed windows
+   * and destroys the tasks that are done.
+   */
+  class TaskRunner {
+    public:
+      TaskRunner(ThreadPool &pool, MainThreadQueue &queue) : m_pool(pool), m_queue(queue) {}
+
+      // Runs task on the calling (main) thread up to its first hop
+      void spawn(const Window &owner, Task<> task) {
+        auto context = std::make_unique<TaskContext>(m_pool, m_queue, owner);
+        auto &promise = task.m_handle.promise();
+        promise.context = context.get();
+        context->m_root = std::move(task);
+        auto handle = context->m_root.m_handle;
+        m_contexts.push_back(std::move(context));
+        handle.resume();
+      }
+
+      void update() {
+        for(auto &context : m_contexts) {
+          if(!context->m_destroyed && !context->cancelled() && context->owner_closed()) {
+            context->m_stop.request_stop();
+          }
+        }
+        std::erase_if(m_contexts, [](const std::unique_ptr<TaskContext> &context) {
+          if(context->m_destroyed) {
+            return true;
+          }
+          if(!context->m_finished.load(std::memory_order_acquire)) {
+            return false;
+          }
+          try {
+            context->m_root.m_handle.promise().result();
+          } catch(const std::exception &e) {
+            spdlog::error("Task failed: {}", e.what());
+          }
+          return true;
+        });
+      }
+
+      // Spawned tasks that haven't finished yet
+      [[nodiscard]] size_t size() const {
+        return m_contexts.size();
+      }
+
+    private:
+      ThreadPool &m_pool;
+      MainThreadQueue &m_queue;
+      std::vector<std::unique_ptr<TaskContext>> m_contexts;
+  };
+}// namespace mv
@@ -0,0 +1,230 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Profiler.h"
+
+namespace mv {
+  /**
+   * Work-stealing thread pool for background jobs.
+   *
+   * Every worker has its own task deque. A worker runs its newest task first and, when its deque
+   * is empty, steals the oldest task of another worker. Tasks submitted from other threads are
+   * spread over the workers round robin. Idle workers sleep until something is submitted.
+   *
+   * Jobs split themselves up with parallel_for(), the calling thread keeps running tasks
+   * (its own or stolen ones) until all parts are done, so nested parallel_for() calls can't
+   * deadlock the pool. Don't call parallel_for() from the UI thread, it waits for the parts.
+   *
+   * Queued tasks are dropped when the pool is destroyed, jobs must not rely on running to the end.
+   *
+   * Every worker counts the time it spent running tasks, the tasks it ran and how many of them it
+   * stole, for the utilisation plots (see ThreadPoolStats).
+   */
+  class ThreadPool {
+    public:
+      using Task = std::function<void()>;
+
+      explicit ThreadPool(size_t thread_count = default_thread_count()) {
+        thread_count = std::max<size_t>(thread_count, 1);
+        for(size_t i = 0; i < thread_count; i++) {
+          m_workers.push_back(std::make_unique<Worker>());
+        }
+        for(size_t i = 0; i < thread_count; i++) {
+          m_threads.emplace_back([this, i] { work(i); });
+        }
+      }
+
+      ThreadPool(const ThreadPool &) = delete;
+      ThreadPool(ThreadPool &&) = delete;
+      ThreadPool &operator=(const ThreadPool &) = delete;
+      ThreadPool &operator=(ThreadPool &&) = delete;
+
+      ~ThreadPool() {
+        {
+          const std::lock_guard lock(m_sleep_mutex);
+          m_stop = true;
+        }
+        m_wake.notify_all();
+        for(auto &thread : m_threads) {
+          thread.join();
+        }
+      }
+
+      // All cores but one, which is left for the UI thread
+      static size_t default_thread_count() {
+        return std::max(std::thread::hardware_concurrency(), 2U) - 1;
+      }
+
+      [[nodiscard]] size_t thread_count() const {
+        return m_threads.size();
+      }
+
+      // Running totals of one worker, read while the worker updates them. busy_ns counts finished
+      // tasks, the one running (if any) started at task_start_ns (steady_clock, 0 when idle).
+      struct Counters {
+        uint64_t busy_ns{0};
+        uint64_t tasks{0};
+        uint64_t steals{0};
+        int64_t task_start_ns{0};
+      };
+
+      [[nodiscard]] Counters counters(size_t worker) const {
+        const auto &w = *m_workers[worker];
+        Counters counters{.tasks = w.tasks_run.load(std::memory_order_relaxed), .steals = w.steals.load(std::memory_order_relaxed)};
+        // Again if a task started or ended in between, its time would be counted twice or not at all
+        do {
+          counters.task_start_ns = w.task_start_ns.load(std::memory_order_acquire);
+          counters.busy_ns = w.busy_ns.load(std::memory_order_acquire);
+        } while(w.task_start_ns.load(std::memory_order_acquire) != counters.task_start_ns);
+        return counters;
+      }
+
+      // Tasks submitted and not started yet
+      [[nodiscard]] size_t queued() const {
+        return m_queued.load(std::memory_order_relaxed);
+      }
+
+      void submit(Task task) {
+        const auto worker = t_pool == this ? t_worker : m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+        {
+          auto &w = *m_workers[worker];
+          const std::lock_guard lock(w.mutex);
+          w.tasks.push_back(std::move(task));
+        }
+        m_queued.fetch_add(1, std::memory_order_release);
+        {
+          // A worker between checking m_queued and going to sleep holds the mutex, taking it here
+          // makes sure the notification isn't lost
+          const std::lock_guard lock(m_sleep_mutex);
+        }
+        m_wake.notify_one();
+      }
+
+      // Runs fn(i) for i in [0, count) on the pool and returns when all calls are done
+      template <typename Fn>
+      void parallel_for(size_t count, Fn &&fn) {
+        if(count == 0) {
+          return;
+        }
+        std::atomic<size_t> remaining{count};
+        for(size_t i = 1; i < count; i++) {
+          submit([&fn, &remaining, i] {
+            fn(i);
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+          });
+        }
+        fn(size_t{0});
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+        const auto self = t_pool == this ? t_worker : 0;
+        while(remaining.load(std::memory_order_acquire) > 0) {
+          if(!run_one(self)) {
+            std::this_thread::yield();
+          }
+        }
+      }
+
+    private:
+      struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<int64_t> task_start_ns{0};
+        std::atomic<uint64_t> tasks_run{0};
+        std::atomic<uint64_t> steals{0};
+      };
+
+      std::vector<std::unique_ptr<Worker>> m_workers;
+      std::vector<std::thread> m_threads;
+      std::atomic<size_t> m_queued{0};
+      std::atomic<size_t> m_next_worker{0};
+      std::mutex m_sleep_mutex;
+      std::condition_variable m_wake;
+      bool m_stop{false};
+
+      static inline thread_local ThreadPool *t_pool{nullptr};
+      static inline thread_local size_t t_worker{0};
+      static inline thread_local int t_depth{0};
+
+      // Own tasks newest first, then the oldest task of the other workers
+      bool run_one(size_t self) {
+        Task task;
+        bool stolen = false;
+        for(size_t i = 0; i < m_workers.size() && !task; i++) {
+          auto &worker = *m_workers[(self + i) % m_workers.size()];
+          const std::lock_guard lock(worker.mutex);
+          if(worker.tasks.empty()) {
+            continue;
+          }
+          if(i == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+          } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            stolen = true;
+          }
+        }
+        if(!task) {
+          return false;
+        }
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        if(t_pool != this) {
+          // A thread outside the pool helping with its parallel_for()
+          task();
+          return true;
+        }
+        // Tasks run while waiting in a nested parallel_for() are part of the outer task's time
+        auto &worker = *m_workers[self];
+        const bool outer = t_depth++ == 0;
+        const auto start = std::chrono::steady_clock::now();
+        if(outer) {
+          worker.task_start_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(), std::memory_order_relaxed);
+        }
+        task();
+        --t_depth;
+        if(outer) {
+          worker.task_start_ns.store(0, std::memory_order_relaxed);
+          worker.busy_ns.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_release);
+        }
+        worker.tasks_run.fetch_add(1, std::memory_order_relaxed);
+        if(stolen) {
+          worker.steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+      }
+
+      void work(size_t index) {
+        t_pool = this;
+        t_worker = index;
+        MV_PROFILE_THREAD_NAME(fmt::format("worker {}", index));
+        while(true) {
+          if(run_one(index)) {
+            continue;
+          }
+          std::unique_lock lock(m_sleep_mutex);
+          m_wake.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) > 0; });
+          if(m_stop) {
+            return;
+          }
+        }
+      }
+  };
+}// namespace mv
@@ -0,0 +1,91 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "MetricSeries.h"
+#include "ThreadPool.h"
+
+namespace mv {
+  /**
+   * Per frame utilisation of the thread pool workers: the share of the time since the previous
+   * frame each worker spent running tasks (0-100 %), plus the tasks run, stolen and still queued.
+   * now_ns must come from steady_clock like the task start times of the pool.
+   */
+  class ThreadPoolStats {
+    public:
+      struct Worker {
+        MetricSeries<float> utilisation;
+        ThreadPool::Counters totals;
+        // Busy time up to the last frame, including the running task
+        uint64_t busy_ns{0};
+        // Tasks run and stolen during the last frame
+        uint64_t tasks{0};
+        uint64_t steals{0};
+      };
+
+      // Call once per frame, now_ns from the same clock every time
+      void collect(const ThreadPool &pool, int64_t now_ns) {
+        if(m_workers.size() != pool.thread_count()) {
+          m_workers.resize(pool.thread_count());
+          for(size_t i = 0; i < m_workers.size(); i++) {
+            m_workers[i].totals = pool.counters(i);
+            m_workers[i].busy_ns = busy_until(m_workers[i].totals, now_ns);
+          }
+          m_last_ns = now_ns;
+          return;
+        }
+
+        const auto elapsed = static_cast<double>(std::max<int64_t>(now_ns - m_last_ns, 1));
+        m_last_ns = now_ns;
+        float sum = 0.0F;
+        for(size_t i = 0; i < m_workers.size(); i++) {
+          auto &worker = m_workers[i];
+          const auto totals = pool.counters(i);
+          // The running task counts up to now, so a long task shows in every frame it runs. The
+          // clocks of the worker and the caller differ a little, keep it within 0-100 %.
+          const auto busy_ns = std::max(busy_until(totals, now_ns), worker.busy_ns);
+          const auto busy = std::min(static_cast<double>(busy_ns - worker.busy_ns) / elapsed, 1.0) * PERCENT;
+          worker.busy_ns = busy_ns;
+          worker.utilisation.push(static_cast<float>(busy));
+          worker.tasks = totals.tasks - worker.totals.tasks;
+          worker.steals = totals.steals - worker.totals.steals;
+          worker.totals = totals;
+          sum += static_cast<float>(busy);
+        }
+        m_mean_utilisation.push(sum / static_cast<float>(m_workers.size()));
+        m_queued.push(static_cast<float>(pool.queued()));
+      }
+
+      [[nodiscard]] const std::vector<Worker> &workers() const {
+        return m_workers;
+      }
+
+      [[nodiscard]] const MetricSeries<float> &mean_utilisation() const {
+        return m_mean_utilisation;
+      }
+
+      [[nodiscard]] const MetricSeries<float> &queued() const {
+        return m_queued;
+      }
+
+    private:
+      static constexpr double PERCENT = 100.0;
+
+      std::vector<Worker> m_workers;
+      MetricSeries<float> m_mean_utilisation;
+      MetricSeries<float> m_queued;
+      int64_t m_last_ns{0};
+
+      static uint64_t busy_until(const ThreadPool::Counters &counters, int64_t now_ns) {
+        if(counters.task_start_ns == 0) {
+          return counters.busy_ns;
+        }
+        return counters.busy_ns + static_cast<uint64_t>(std::max<int64_t>(now_ns - counters.task_start_ns, 0));
+      }
+  };
+}// namespace mv
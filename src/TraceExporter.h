@@ -0,0 +1,150 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "FrameTimeline.h"
+#include "Profiler.h"
+
+namespace mv {
+  /**
+   * Writes frame phases and profiler zones as Chrome Trace Event JSON (chrome://tracing,
+   * https://ui.perfetto.dev) on a background thread.
+   *
+   * The caller hands over a copy of the data, the render loop never waits for the file to be written.
+   */
+  class TraceExporter {
+    public:
+      struct Trace {
+        std::filesystem::path path;
+        std::vector<FrameRecord> frames;
+        std::vector<profiler::ZoneEvent> zones;
+        std::vector<std::string> thread_names;
+      };
+
+      TraceExporter() : m_thread([this] { worker(); }) {}
+
+      TraceExporter(const TraceExporter &) = delete;
+      TraceExporter(TraceExporter &&) = delete;
+      TraceExporter &operator=(const TraceExporter &) = delete;
+      TraceExporter &operator=(TraceExporter &&) = delete;
+
+      // Pending exports are finished before the thread exits
+      ~TraceExporter() {
+        {
+          const std::scoped_lock lock(m_mutex);
+          m_should_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+      }
+
+      void export_async(Trace trace) {
+        {
+          const std::scoped_lock lock(m_mutex);
+          m_queue.push_back(std::move(trace));
+        }
+        m_cv.notify_one();
+      }
+
+      [[nodiscard]] bool busy() const {
+        return m_busy.load(std::memory_order_relaxed);
+      }
+
+    private:
+      std::mutex m_mutex;
+      std::condition_variable m_cv;
+      std::deque<Trace> m_queue;
+      bool m_should_stop{false};
+      std::atomic<bool> m_busy{false};
+      std::thread m_thread;// last, the worker uses the members above
+
+      static constexpr int PID = 1;
+      static constexpr uint32_t FRAME_TID = 10000;// separate track for the frame phases
+      static constexpr double NS_PER_US = 1000.0;
+
+      void worker() {
+        MV_PROFILE_THREAD_NAME("trace exporter");
+        while(true) {
+          Trace trace;
+          {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_should_stop || !m_queue.empty(); });
+            if(m_queue.empty()) {
+              return;
+            }
+            trace = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+          }
+
+          try {
+            write(trace);
+            spdlog::info("Wrote trace with {} frames and {} zones to {}", trace.frames.size(), trace.zones.size(), trace.path.string());
+          } catch(std::exception &e) {
+            spdlog::error("Could not write trace {}: {}", trace.path.string(), e.what());
+          }
+          m_busy = false;
+        }
+      }
+
+      static void write(const Trace &trace) {
+        std::ofstream out(trace.path);
+        if(!out) {
+          throw std::runtime_error("could not open file");
+        }
+
+        // Streamed one event at a time instead of building one big document
+        bool first = true;
+        const auto emit = [&out, &first](const nlohmann::json &event) {
+          out << (first ? "\n" : ",\n") << event.dump();
+          first = false;
+        };
+
+        out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+
+        for(size_t tid = 0; tid < trace.thread_names.size(); tid++) {
+          emit({{"name", "thread_name"}, {"ph", "M"}, {"pid", PID}, {"tid", tid}, {"args", {{"name", trace.thread_names[tid]}}}});
+        }
+        emit({{"name", "thread_name"}, {"ph", "M"}, {"pid", PID}, {"tid", FRAME_TID}, {"args", {{"name", "frames"}}}});
+
+        const auto complete = [&emit](const char *name, const char *category, uint32_t tid, int64_t begin_ns, int64_t end_ns) {
+          emit({{"name", name}, {"cat", category}, {"ph", "X"}, {"pid", PID}, {"tid", tid}, {"ts", static_cast<double>(begin_ns) / NS_PER_US}, {"dur", static_cast<double>(end_ns - begin_ns) / NS_PER_US}});
+        };
+
+        for(const auto &frame : trace.frames) {
+          complete("Frame", "frame", FRAME_TID, frame.begin_ns, frame.end_ns);
+          for(size_t phase = 0; phase < PHASE_COUNT; phase++) {
+            const auto &span = frame.phases.at(phase);
+            if(span.end_ns > span.begin_ns) {
+              complete(PHASE_NAMES.at(phase), "phase", FRAME_TID, span.begin_ns, span.end_ns);
+            }
+          }
+        }
+
+        for(const auto &zone : trace.zones) {
+          complete(zone.name, "zone", zone.thread, zone.begin_ns, zone.end_ns);
+        }
+
+        out << "\n]}\n";
+        if(!out) {
+          throw std::runtime_error("write failed");
+        }
+      }
+  };
+}// namespace mv
\ No newline at end of file
@@ -0,0 +1,389 @@
+// Copyright (C) 2022, Fredrik Andersson
+// SPDX-License-Identifier: CC-BY-NC-4.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ItemStore.h"
+#include "Profiler.h"
+#include "StringMatch.h"
+
+namespace mv {
+  /**
+   * Sorted list of item ids, delta and varint encoded.
+   *
+   * Every SKIP_INTERVAL:th id is stored in full and remembered in a skip table, so a cursor can
+   * jump close to an id without decoding everything in front of it.
+   */
+  class PostingList {
+    public:
+      static constexpr uint32_t SKIP_INTERVAL = 128;
+
+      // Ids must be added in increasing order
+      void add(uint32_t id) {
+        auto value = id - m_last;
+        if(m_count % SKIP_INTERVAL == 0) {
+          m_skips.push_back(Skip{id, static_cast<uint32_t>(m_bytes.size())});
+          value = id;
+        }
+        while(value >= VARINT_CONTINUE) {
+          m_bytes.push_back(static_cast<uint8_t>(value | VARINT_CONTINUE));
+          value >>= VARINT_BITS;
+        }
+        m_bytes.push_back(static_cast<uint8_t>(value));
+        m_last = id;
+        ++m_count;
+      }
+
+      [[nodiscard]] uint32_t size() const {
+        return m_count;
+      }
+
+      [[nodiscard]] size_t memory_usage() const {
+        return sizeof(PostingList) + m_bytes.capacity() + m_skips.capacity() * sizeof(Skip);
+      }
+
+      template <typename Visit>
+      void for_each(Visit &&visit) const {
+        for(Cursor cursor{*this}; cursor.valid(); cursor.next()) {
+          visit(cursor.id());
+        }
+      }
+
+      class Cursor {
+        public:
+          explicit Cursor(const PostingList &list) : m_list(list) {
+            if(m_list.m_count > 0) {
+              m_id = decode();
+            }
+          }
+
+          [[nodiscard]] bool valid() const {
+            return m_index < m_list.m_count;
+          }
+
+          [[nodiscard]] uint32_t id() const {
+            return m_id;
+          }
+
+          void next() {
+            if(++m_index < m_list.m_count) {
+              const auto value = decode();
+              m_id = m_index % SKIP_INTERVAL == 0 ? value : m_id + value;
+            }
+          }
+
+          // Moves to the first id >= target, returns false if there is none
+          bool seek(uint32_t target) {
+            if(!valid() || m_id >= target) {
+              return valid();
+            }
+
+            const auto &skips = m_list.m_skips;
+            const auto block = m_index / SKIP_INTERVAL;
+            const auto it = std::upper_bound(skips.begin() + block + 1, skips.end(), target, [](uint32_t t, const Skip &skip) { return t < skip.id; });
+            const auto skip = static_cast<uint32_t>(it - skips.begin()) - 1;
+            if(skip > block) {
+              m_index = skip * SKIP_INTERVAL;
+              m_offset = skips[skip].offset;
+              m_id = decode();
+            }
+            while(valid() && m_id < target) {
+              next();
+            }
+            return valid();
+          }
+
+        private:
+          const PostingList &m_list;
+          uint32_t m_index{0};
+          uint32_t m_offset{0};
+          uint32_t m_id{0};
+
+          uint32_t decode() {
+            uint32_t value = 0;
+            uint32_t shift = 0;
+            uint8_t byte = 0;
+            do {
+              byte = m_list.m_bytes[m_offset++];
+              value |= static_cast<uint32_t>(byte & ~VARINT_CONTINUE) << shift;
+              shift += VARINT_BITS;
+            } while((byte & VARINT_CONTINUE) != 0);
+            return value;
+          }
+      };
+
+    private:
+      struct Skip {
+        uint32_t id;
+        uint32_t offset;
+      };
+
+      static constexpr uint32_t VARINT_BITS = 7;
+      static constexpr uint8_t VARINT_CONTINUE = 0x80;
+
+      std::vector<uint8_t> m_bytes;
+      std::vector<Skip> m_skips;
+      uint32_t m_last{0};
+      uint32_t m_count{0};
+  };
+
+  /**
+   * Case insensitive (ASCII) trigram index over the items of an ItemStore.
+   *
+   * Every item is added to the posting list of each distinct trigram it contains. A query of three
+   * or more characters then only has to look at the items that contain all of its trigrams,
+   * which is usually a tiny fraction of the list.
+   *
+   * The index covers the first size() items of the store and catches up in update(), a little
+   * at a time, so it can follow a store that grows while it's being loaded. Other threads query
+   * it through a Reader, update() leaves the index alone while one is alive.
+   */
+  class TrigramIndex {
+    private:
+      struct Data;
+
+    public:
+      static constexpr size_t TRIGRAM_LENGTH = 3;
+
+      /**
+       * Read access from another thread, meant to live for one query. Keeps the posting lists
+       * alive when the index goes away.
+       */
+      class Reader {
+        public:
+          Reader(const Reader &other) : Reader(other.m_data) {}
+          Reader(Reader &&other) noexcept = default;
+          Reader &operator=(const Reader &other) {
+            if(this != &other) {
+              *this = Reader(other);
+            }
+            return *this;
+          }
+          Reader &operator=(Reader &&other) noexcept {
+            if(this != &other) {
+              release();
+              m_data = std::move(other.m_data);
+            }
+            return *this;
+          }
+
+          ~Reader() {
+            release();
+          }
+
+          // See TrigramIndex::candidates()
+          [[nodiscard]] std::optional<std::vector<uint32_t>> candidates(std::string_view query) const {
+            return m_data->candidates(query);
+          }
+
+        private:
+          friend class TrigramIndex;
+
+          std::shared_ptr<const Data> m_data;
+
+          explicit Reader(std::shared_ptr<const Data> data) : m_data(std::move(data)) {
+            if(m_data) {
+              m_data->readers.fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+
+          // The index is changed after the last reader is done with it
+          void release() {
+            if(m_data) {
+              m_data->readers.fetch_sub(1, std::memory_order_release);
+              m_data.reset();
+            }
+          }
+      };
+
+      // Indexes items appended to the store since the last call until the budget is spent. Does
+      // nothing while a Reader is alive.
+      void update(const ItemStore &items, std::chrono::nanoseconds budget) {
+        auto &data = *m_data;
+        if(data.size >= items.size() || data.readers.load(std::memory_order_acquire) != 0) {
+          return;
+        }
+        MV_PROFILE_SCOPE("TrigramIndex::update");
+        static constexpr size_t ITEMS_PER_CLOCK_CHECK = 256;
+        const auto start = std::chrono::steady_clock::now();
+        while(data.size < items.size()) {
+          const auto &chunk = items.chunk_of(data.size);
+          // The tail chunk of a forked store can hold items appended after the fork
+          const auto end = std::min({chunk.first_item() + chunk.size(), items.size(), data.size + ITEMS_PER_CLOCK_CHECK});
+          for(; data.size < end; data.size++) {
+            add(static_cast<uint32_t>(data.size), chunk[static_cast<uint32_t>(data.size - chunk.first_item())]);
+          }
+          if(std::chrono::steady_clock::now() - start >= budget) {
+            break;
+          }
+        }
+      }
+
+      // Readers keep the old lists
+      void clear() {
+        m_data = std::make_shared<Data>();
+      }
+
+      // Number of items indexed
+      [[nodiscard]] size_t size() const {
+        return m_data->size;
+      }
+
+      [[nodiscard]] size_t memory_usage() const {
+        size_t bytes = sizeof(TrigramIndex) + sizeof(Data) + m_data->tables.capacity() * sizeof(Table) + m_data->lists.capacity() * sizeof(PostingList);
+        for(const auto &table : m_data->tables) {
+          bytes += table.capacity() * sizeof(uint32_t);
+        }
+        for(const auto &list : m_data->lists) {
+          bytes += list.memory_usage() - sizeof(PostingList);
+        }
+        return bytes;
+      }
+
+      // Upper bound of the number of candidates() for the (lower case) query, the size of the
+      // rarest trigram's posting list. Nothing if the query is too short to use the index.
+      [[nodiscard]] std::optional<size_t> candidate_bound(std::string_view query) const {
+        if(query.size() < TRIGRAM_LENGTH) {
+          return std::nullopt;
+        }
+        const auto lists = m_data->posting_lists(query);
+        return lists.empty() ? 0 : lists.front()->size();
+      }
+
+      // Sorted ids of the indexed items that contain the trigrams of the (lower case) query, i.e.
+      // a superset of the matches that has to be verified unless the query is a single trigram.
+      // Nothing if the query is too short to use the index.
+      //
+      // The remaining posting lists are only intersected while there are few candidates, with
+      // many candidates it's cheaper to leave it to the verification, which can be spread out
+      // over several frames.
+      [[nodiscard]] std::optional<std::vector<uint32_t>> candidates(std::string_view query) const {
+        return m_data->candidates(query);
+      }
+
+      // For candidates() on another thread, covering the first size() items
+      [[nodiscard]] Reader reader() const {
+        return Reader{m_data};
+      }
+
+    private:
+      // The posting list of trigram abc is lists[tables[ab][c] - 1], a table of 256 list numbers
+      // is allocated for each leading pair of bytes that occurs. Cheaper than hashing every
+      // trigram of every item.
+      using Table = std::vector<uint32_t>;
+
+      static constexpr uint32_t BYTE_BITS = 8;
+      static constexpr uint32_t BYTE_VALUES = 1U << BYTE_BITS;
+
+      static constexpr size_t MAX_INTERSECTED_CANDIDATES = 1U << 16U;
+
+      struct Data {
+        std::vector<Table> tables;
+        std::vector<PostingList> lists;
+        size_t size{0};
+        // Readers alive, mutable so a const Reader can count itself
+        mutable std::atomic<uint32_t> readers{0};
+
+        [[nodiscard]] const PostingList *find(uint32_t key) const {
+          const auto pair = key >> BYTE_BITS;
+          if(pair >= tables.size() || tables[pair].empty()) {
+            return nullptr;
+          }
+          const auto list = tables[pair][key & (BYTE_VALUES - 1)];
+          return list == 0 ? nullptr : &lists[list - 1];
+        }
+
+        // Posting lists of the query's trigrams, rarest first. Empty if any of them doesn't occur.
+        [[nodiscard]] std::vector<const PostingList *> posting_lists(std::string_view query) const {
+          std::vector<const PostingList *> found;
+          for(const auto key : trigrams(query)) {
+            const auto *list = find(key);
+            if(list == nullptr) {
+              return {};
+            }
+            found.push_back(list);
+          }
+          std::sort(found.begin(), found.end(), [](const PostingList *a, const PostingList *b) { return a->size() < b->size(); });
+          return found;
+        }
+
+        [[nodiscard]] std::optional<std::vector<uint32_t>> candidates(std::string_view query) const {
+          if(query.size() < TRIGRAM_LENGTH) {
+            return std::nullopt;
+          }
+          MV_PROFILE_SCOPE("TrigramIndex::candidates");
+
+          const auto found = posting_lists(query);
+          if(found.empty()) {
+            return std::vector<uint32_t>{};
+          }
+
+          // Start from the rarest trigram, every other list only has to be probed at the remaining ids
+          std::vector<uint32_t> ids;
+          ids.reserve(found.front()->size());
+          found.front()->for_each([&ids](uint32_t id) { ids.push_back(id); });
+          for(size_t i = 1; i < found.size() && !ids.empty() && ids.size() <= MAX_INTERSECTED_CANDIDATES; i++) {
+            PostingList::Cursor cursor{*found[i]};
+            std::erase_if(ids, [&cursor](uint32_t id) { return !cursor.seek(id) || cursor.id() != id; });
+          }
+          return ids;
+        }
+      };
+
+      std::shared_ptr<Data> m_data{std::make_shared<Data>()};
+      std::vector<uint32_t> m_keys;
+
+      PostingList &find_or_add(uint32_t key) {
+        auto &data = *m_data;
+        if(data.tables.empty()) {
+          data.tables.resize(size_t{BYTE_VALUES} * BYTE_VALUES);
+        }
+        auto &table = data.tables[key >> BYTE_BITS];
+        if(table.empty()) {
+          table.resize(BYTE_VALUES);
+        }
+        auto &list = table[key & (BYTE_VALUES - 1)];
+        if(list == 0) {
+          data.lists.emplace_back();
+          list = static_cast<uint32_t>(data.lists.size());
+        }
+        return data.lists[list - 1];
+      }
+
+      static uint32_t key(char a, char b, char c) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(a)) << (2 * BYTE_BITS)) | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << BYTE_BITS) | static_cast<uint8_t>(c);
+      }
+
+      // Distinct trigrams of text, lower cased
+      static std::vector<uint32_t> trigrams(std::string_view text) {
+        std::vector<uint32_t> keys;
+        append_trigrams(text, keys);
+        return keys;
+      }
+
+      static void append_trigrams(std::string_view text, std::vector<uint32_t> &keys) {
+        keys.clear();
+        for(size_t i = 0; i + TRIGRAM_LENGTH <= text.size(); i++) {
+          keys.push_back(key(match::to_lower(text[i]), match::to_lower(text[i + 1]), match::to_lower(text[i + 2])));
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+      }
+
+      void add(uint32_t id, std::string_view item) {
+        append_trigrams(item, m_keys);
+        for(const auto key : m_keys) {
+          find_or_add(key).add(id);
+        }
+      }
+  };
+}// namespace mv
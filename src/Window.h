@@ -3,13 +3,22 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+#include <string_view>
+
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <implot.h>
 #include <spdlog/spdlog.h>
 
+#include "SlotMap.h"
+
 
 namespace mv {
+  // A window of the application, refers to nothing once the window is closed
+  using WindowHandle = SlotKey;
+
   class Window {
     public:
       Window() = default;
@@ -21,13 +30,161 @@ namespace mv {
       Window &operator=(const Window &) = default;
       Window &operator=(Window &&) = default;
 
+      // Where ImGui put the window last frame
+      enum class Visibility {
+        VISIBLE,
+        COLLAPSED,
+        HIDDEN_TAB,
+        OFF_SCREEN,
+        OCCLUDED
+      };
+
+      // Keeps the data of the window current, called every frame before render() whether or not
+      // the window is visible. Work only the drawing needs belongs in render().
+      virtual void update() {}
+
+      // Must call ImGui::Begin() every frame, or a docked window loses its tab, but should only
+      // draw the contents when begin_window() says so.
       virtual void render() = 0;
 
       [[nodiscard]] bool should_close() const {
         return !m_is_open;
       }
 
+      // Removed after the current frame
+      void close() {
+        m_is_open = false;
+      }
+
+      [[nodiscard]] Visibility visibility() const {
+        return m_visibility;
+      }
+
+      [[nodiscard]] bool is_visible() const {
+        return m_visibility == Visibility::VISIBLE;
+      }
+
+      // Called by the application at the start of the frame, before update()
+      void update_visibility() {
+        m_visibility = find_visibility(m_window_title);
+      }
+
+      // In reactive mode the application only renders when something happened, windows that
+      // animate (plots etc.) override this to keep getting frames.
+      [[nodiscard]] virtual bool needs_continuous_redraw() const {
+        return false;
+      }
+
+      // Ask for (at least) one more frame, e.g. when a data source has posted an update.
+      void mark_dirty() {
+        m_is_dirty = true;
+      }
+
+      [[nodiscard]] bool is_dirty() const {
+        return m_is_dirty;
+      }
+
+      void clear_dirty() {
+        m_is_dirty = false;
+      }
+
+      [[nodiscard]] const std::string &title() const {
+        return m_window_title;
+      }
+
+      // Title without the "###id" part ImGui uses for identification
+      [[nodiscard]] std::string_view display_title() const {
+        const std::string_view title{m_window_title};
+        return title.substr(0, title.find("###"));
+      }
+
+      // Time spent in the last update() and render() calls, measured by the application.
+      [[nodiscard]] float last_render_ms() const {
+        return m_last_render_ms;
+      }
+
+      void set_last_render_ms(float ms) {
+        m_last_render_ms = ms;
+      }
+
+      // Expires when the window is destroyed, owner of work that finishes on the main thread
+      // later (see MainThreadQueue and Task.h)
+      [[nodiscard]] std::weak_ptr<const void> lifetime() const {
+        return m_lifetime;
+      }
+
+      // Set by the application when the window is added, can be kept across frames and handed to
+      // other threads (see Application::window())
+      [[nodiscard]] WindowHandle handle() const {
+        return m_handle;
+      }
+
+      void set_handle(WindowHandle handle) {
+        m_handle = handle;
+      }
+
     protected:
       bool m_is_open{true};// NOLINT: cppcoreguidelines-non-private-member-variables-in-classes
+      std::string m_window_title;// NOLINT: cppcoreguidelines-non-private-member-variables-in-classes
+
+      // ImGui::Begin() for the window, false when the contents don't need to be drawn: collapsed or
+      // in a hidden tab (ImGui knows right away), off-screen or covered (as of last frame). Call
+      // ImGui::End() either way.
+      bool begin_window(ImGuiWindowFlags flags) {
+        const bool open = ImGui::Begin(m_window_title.c_str(), &m_is_open, flags);
+        return open && m_visibility != Visibility::OFF_SCREEN && m_visibility != Visibility::OCCLUDED;
+      }
+
+    private:
+      bool m_is_dirty{true};
+      Visibility m_visibility{Visibility::VISIBLE};
+      float m_last_render_ms{0.0F};
+      WindowHandle m_handle;
+      std::shared_ptr<const void> m_lifetime{std::make_shared<char>()};
+
+      // Conservative, anything unclear counts as visible: a window that hasn't been shown yet, any
+      // window while something is dragged (windows move, docks resize) or a popup is open. Covered
+      // means by a single opaque window that is in front of it, on the same viewport.
+      static Visibility find_visibility(const std::string &title) {
+        const auto &g = *ImGui::GetCurrentContext();
+        const auto *window = ImGui::FindWindowByName(title.c_str());
+        if(window == nullptr || !window->WasActive) {
+          return Visibility::VISIBLE;
+        }
+        if(window->Collapsed) {
+          return Visibility::COLLAPSED;
+        }
+        if(window->DockIsActive && !window->DockTabIsVisible) {
+          return Visibility::HIDDEN_TAB;
+        }
+        if(g.MovingWindow != nullptr || g.OpenPopupStack.Size > 0 || ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+          return Visibility::VISIBLE;
+        }
+
+        const auto rect = window->Rect();
+        if(window->Viewport != nullptr && !rect.Overlaps(window->Viewport->GetMainRect())) {
+          return Visibility::OFF_SCREEN;
+        }
+
+        if(g.Style.Colors[ImGuiCol_WindowBg].w < 1.0F) {
+          return Visibility::VISIBLE;
+        }
+        constexpr auto SEE_THROUGH = ImGuiWindowFlags_NoBackground | ImGuiWindowFlags_ChildWindow | ImGuiWindowFlags_Popup | ImGuiWindowFlags_Tooltip;
+        const auto *root = window->RootWindowDockTree;
+        bool in_front = false;
+        for(const auto *other : g.Windows) {// back to front
+          if(other == root) {
+            in_front = true;
+            continue;
+          }
+          if(!in_front || other->RootWindowDockTree != other || !other->WasActive || other->Hidden || other->Collapsed || other->Viewport != window->Viewport || (other->Flags & SEE_THROUGH) != 0) {
+            continue;
+          }
+          if(other->Rect().Contains(rect)) {
+            return Visibility::OCCLUDED;
+          }
+        }
+        return Visibility::VISIBLE;
+      }
   };
 }// namespace mv
\ No newline at end of file
@@ -1,7 +1,11 @@
 // Copyright (C) 2022, Fredrik Andersson
 // SPDX-License-Identifier: CC-BY-NC-4.0
 
+#include <charconv>
 #include <exception>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #include <spdlog/spdlog.h>
 
@@ -13,17 +17,82 @@
  *
  ************************/
 
-int main(int /*argc*/, char ** /*argv*/) {
+namespace {
+  void print_usage(std::string_view name) {
+    spdlog::info("usage: {} [--headless] [--frames <count>] [--reactive] [--trace <file.json>] [--history <samples>] [--store <file.mvstore>]", name);
+  }
+
+  // Options followed by a value
+  bool takes_value(std::string_view arg) {
+    return arg == "--trace" || arg == "--store" || arg == "--history" || arg == "--frames";
+  }
+
+  // False unless all of text is a number
+  template <typename T>
+  bool parse_number(std::string_view text, T &value) {
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+  }
+
+  std::optional<mv::ApplicationOptions> parse_args(std::span<char *> args) {
+    mv::ApplicationOptions options;
+
+    for(size_t i = 1; i < args.size(); i++) {
+      const std::string_view arg{args[i]};
+      if(takes_value(arg) && i + 1 == args.size()) {
+        spdlog::error("Missing value for {}", arg);
+        return std::nullopt;
+      }
+      if(arg == "--headless") {
+        options.headless = true;
+      } else if(arg == "--reactive") {
+        options.reactive = true;
+      } else if(arg == "--trace") {
+        options.trace_path = args[++i];
+      } else if(arg == "--store") {
+        options.store_path = args[++i];
+      } else if(arg == "--history") {
+        const std::string_view value{args[++i]};
+        if(!parse_number(value, options.history_length) || options.history_length == 0) {
+          spdlog::error("Invalid history length: {}", value);
+          return std::nullopt;
+        }
+        if(options.history_length > mv::MetricSeries<float>::MAX_CAPACITY) {
+          spdlog::error("History length {} is above the maximum of {}", options.history_length, mv::MetricSeries<float>::MAX_CAPACITY);
+          return std::nullopt;
+        }
+      } else if(arg == "--frames") {
+        const std::string_view value{args[++i]};
+        if(!parse_number(value, options.headless_frames) || options.headless_frames <= 0) {
+          spdlog::error("Invalid frame count: {}", value);
+          return std::nullopt;
+        }
+      } else {
+        spdlog::error("Unknown argument: {}", arg);
+        return std::nullopt;
+      }
+    }
+    return options;
+  }
+}// namespace
+
+int main(int argc, char **argv) {
   spdlog::info("-=gui=-");
+
+  const auto args = std::span(argv, static_cast<size_t>(argc));
+  const auto options = parse_args(args);
+  if(!options) {
+    print_usage(args.empty() ? "multiview" : args[0]);
+    return -1;
+  }
+
   try {
-    mv::Application app;
-    app.run();
+    mv::Application app{*options};
+    return app.run();
   } catch(std::exception &e) {
     spdlog::error("{}", e.what());
     return -1;
   } catch(...) {
     return -1;
   }
-
-  return 0;
-}
+}
\ No newline at end of file